@@ -0,0 +1,50 @@
+#!/bin/sh
+#
+# Runs the same load against an epoll server with four threads in each
+# durability mode (none, sync and periodic, see SMSL_DURABILITY) and
+# reports the posts per second and the latency of a post until it is
+# acknowledged (median, 99th percentile and maximum in microseconds).
+#
+# The posts go to the bulletin board of the user running the benchmark,
+# with the user name load.
+#
+# usage: durability.sh simple_message_server [clients [posts per client]]
+#
+# The directory ~/public_html has to exist. The compiler is taken from
+# CC (default cc).
+
+SERVER=$1
+CLIENTS=${2:-16}
+POSTS=${3:-500}
+TMP=$(mktemp -d) || exit 1
+PID=
+
+cleanup() {
+  [ -n "$PID" ] && kill "$PID" 2>/dev/null
+  wait 2>/dev/null
+  rm -rf "$TMP"
+}
+trap cleanup EXIT
+
+[ -x "$SERVER" ] || { echo "usage: $0 simple_message_server [clients [posts per client]]" >&2; exit 1; }
+[ -d "$HOME/public_html" ] || { echo "the bulletin board needs the directory ~/public_html" >&2; exit 1; }
+
+${CC:-cc} -O2 -Wall -Wextra -pthread -o "$TMP/post_load" "$(dirname "$0")/post_load.c" || exit 1
+
+PORT=$(( 20000 + $$ % 20000 ))
+for mode in none sync periodic; do
+  SMSL_DURABILITY=$mode "$SERVER" -p "$PORT" -b epoll -t 4 >/dev/null 2>>"$TMP/server.err" &
+  PID=$!
+  sleep 1
+  "$TMP/post_load" "$PORT" "$CLIENTS" "$POSTS" || exit 1
+  kill "$PID"
+  wait "$PID" 2>/dev/null
+  PID=
+  PORT=$(( PORT + 1 ))
+done
+
+if grep -q . "$TMP/server.err"; then
+  echo "the server reported errors: $(head -c 500 "$TMP/server.err")" >&2
+  exit 1
+fi
+exit 0
@@ -0,0 +1,246 @@
+#define _GNU_SOURCE /* getline() */
+
+#include <err.h>
+#include <errno.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MESSAGE_LEN 200
+#define MAX_CLIENTS 256
+#define MAX_DURABILITYLEN 16
+
+typedef struct {
+  pthread_t thread;
+  const char *port;
+  long posts;
+  long id;
+  double *latencies; /* of every post in microseconds */
+  char durability[MAX_DURABILITYLEN]; /* as reported by the server */
+  int status;
+} client_t;
+
+static double now(void);
+static int connect_server(const char *port);
+static void *post_messages(void *arg);
+static int post(FILE *stream, const char *request, size_t len, char *durability);
+static int compare(const void *a, const void *b);
+
+/**
+ * @brief posts from many clients at once and reports the throughput and latency
+ *
+ * Every client posts over a version 2 connection of its own, one message
+ * after the other with a status-only reply, so the latency of a post is
+ * the time until it is acknowledged.
+ *
+ * usage: post_load port clients posts
+ *
+ * @returns EXIT_SUCCESS, EXIT_FAILURE
+ */
+int main(int argc, char *argv[]) {
+  client_t clients[MAX_CLIENTS];
+  double *latencies, start, elapsed;
+  long count, posts, i, total;
+  int status = EXIT_SUCCESS;
+
+  if (argc != 4 || (count = strtol(argv[2], NULL, 10)) < 1 || count > MAX_CLIENTS ||
+      (posts = strtol(argv[3], NULL, 10)) < 1) {
+    fprintf(stderr, "Usage: %s port clients posts\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  total = count * posts;
+  if ((latencies = malloc(total * sizeof(*latencies))) == NULL) {
+    err(EXIT_FAILURE, "malloc");
+  }
+
+  start = now();
+  for (i = 0; i < count; i++) {
+    clients[i] = (client_t){0, argv[1], posts, i, latencies + i * posts, "", 0};
+    if ((errno = pthread_create(&clients[i].thread, NULL, post_messages, &clients[i])) != 0) {
+      err(EXIT_FAILURE, "pthread_create");
+    }
+  }
+  for (i = 0; i < count; i++) {
+    pthread_join(clients[i].thread, NULL);
+    if (clients[i].status == -1) {
+      status = EXIT_FAILURE;
+    }
+  }
+  elapsed = now() - start;
+
+  if (status == EXIT_SUCCESS) {
+    qsort(latencies, total, sizeof(*latencies), compare);
+    printf("durability=%s posts=%ld posts_per_s=%.0f p50_us=%.0f p99_us=%.0f max_us=%.0f\n",
+           clients[0].durability, total, total / (elapsed / 1e6), latencies[total / 2],
+           latencies[total * 99 / 100], latencies[total - 1]);
+  }
+
+  free(latencies);
+
+  return status;
+}
+
+/**
+ * @brief returns the monotonic time in microseconds
+ */
+static double now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/**
+ * @brief connects to the server on localhost
+ *
+ * @param port the port of the server
+ *
+ * @returns the socket or -1 in case of error
+ */
+static int connect_server(const char *port) {
+  struct addrinfo hints, *ai;
+  int sock, rc;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  if ((rc = getaddrinfo("localhost", port, &hints, &ai)) != 0) {
+    warnx("getaddrinfo: %s", gai_strerror(rc));
+    return -1;
+  }
+
+  if ((sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) == -1) {
+    warn("socket");
+  } else if (connect(sock, ai->ai_addr, ai->ai_addrlen) == -1) {
+    warn("connect");
+    close(sock);
+    sock = -1;
+  }
+
+  freeaddrinfo(ai);
+
+  return sock;
+}
+
+/**
+ * @brief the thread of a client, posts its messages over one connection
+ *
+ * @param arg the client
+ *
+ * @returns NULL
+ */
+static void *post_messages(void *arg) {
+  client_t *client = arg;
+  char message[MESSAGE_LEN + 1];
+  char fields[MESSAGE_LEN + 128];
+  char request[sizeof(fields) + 32];
+  char *line = NULL;
+  size_t line_len = 0;
+  FILE *stream = NULL;
+  double start;
+  int sock, len, fields_len;
+  long i;
+
+  client->status = -1;
+
+  if ((sock = connect_server(client->port)) == -1 || (stream = fdopen(sock, "r+")) == NULL) {
+    if (sock != -1) {
+      close(sock);
+    }
+    return NULL;
+  }
+
+  /* a version 1 server would take the greeting for a request and not answer */
+  if (fputs("version=2\n", stream) == EOF || fflush(stream) == EOF ||
+      getline(&line, &line_len, stream) == -1 || strcmp(line, "version=2\n") != 0) {
+    warnx("Client %ld: the server does not speak version 2", client->id);
+    goto out;
+  }
+
+  for (i = 0; i < client->posts; i++) {
+    len = snprintf(message, sizeof(message), "load %ld %ld ", client->id, i);
+    memset(message + len, 'x', MESSAGE_LEN - len);
+    message[MESSAGE_LEN] = '\0';
+
+    fields_len = snprintf(fields, sizeof(fields), "user=4\nloadmessage=%d\n%sreply=6\nstatusdurability=3\nyes",
+                          MESSAGE_LEN, message);
+    len = snprintf(request, sizeof(request), "request=%d\n%s", fields_len, fields);
+
+    start = now();
+    if (post(stream, request, len, client->durability) == -1) {
+      warnx("Client %ld: post %ld failed", client->id, i);
+      goto out;
+    }
+    client->latencies[i] = now() - start;
+  }
+
+  client->status = 0;
+
+out:
+  free(line);
+  fclose(stream);
+
+  return NULL;
+}
+
+/**
+ * @brief sends a request and receives its status-only response
+ *
+ * @param stream the connection
+ * @param request the request
+ * @param len the length of the request
+ * @param durability where to save the durability reported by the server
+ *
+ * @returns 0 if the post succeeded or -1 in case of error
+ */
+static int post(FILE *stream, const char *request, size_t len, char *durability) {
+  char *line = NULL;
+  size_t line_len = 0;
+  long status = -1, error_len;
+  int rc = -1;
+
+  if (fwrite(request, 1, len, stream) != len || fflush(stream) == EOF) {
+    return -1;
+  }
+
+  /* status=<n>, durability=<mode>, error=<n> with the message, files=0 */
+  while (getline(&line, &line_len, stream) != -1) {
+    if (sscanf(line, "status=%ld", &status) == 1) {
+      continue;
+    }
+    if (sscanf(line, "durability=%15s", durability) == 1) {
+      continue;
+    }
+    if (sscanf(line, "error=%ld", &error_len) == 1) {
+      while (error_len-- > 0 && fgetc(stream) != EOF) {
+        /* skip the message */
+      }
+      continue;
+    }
+    if (strcmp(line, "files=0\n") == 0) {
+      rc = (status == 0) ? 0 : -1;
+    }
+    break;
+  }
+
+  free(line);
+
+  return rc;
+}
+
+/**
+ * @brief compares two latencies for qsort()
+ */
+static int compare(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
@@ -0,0 +1,163 @@
+#define _GNU_SOURCE /* MAP_POPULATE */
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PROGRAM "/bin/true"
+#define MIB (1024L * 1024L)
+
+extern char **environ;
+
+static double now(void);
+static pid_t launch_fork(int in);
+static pid_t launch_spawn(int in);
+static double measure(pid_t (*launch)(int), int in, long launches);
+
+/**
+ * @brief compares the cost of launching a child with fork() and execve()
+ * and with posix_spawn() at different sizes of the parent
+ *
+ * The child is launched the way exec_logic() of the server launches the
+ * logic, with its stdin redirected, and the parent waits for it. The
+ * parent grows to every size given in MiB by mapping and touching that
+ * much memory.
+ *
+ * usage: spawn_cost launches size...
+ *
+ * @returns EXIT_SUCCESS, EXIT_FAILURE
+ */
+int main(int argc, char *argv[]) {
+  char *memory;
+  long launches, size;
+  double forked, spawned;
+  int in, i;
+
+  if (argc < 3 || (launches = strtol(argv[1], NULL, 10)) < 1) {
+    fprintf(stderr, "Usage: %s launches size...\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if ((in = open("/dev/null", O_RDONLY | O_CLOEXEC)) == -1) {
+    err(EXIT_FAILURE, "open");
+  }
+
+  printf("%10s %12s %12s\n", "rss_mib", "fork_us", "spawn_us");
+
+  for (i = 2; i < argc; i++) {
+    size = strtol(argv[i], NULL, 10);
+    memory = NULL;
+    if (size > 0 && (memory = mmap(NULL, size * MIB, PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0)) == MAP_FAILED) {
+      err(EXIT_FAILURE, "mmap");
+    }
+    if (memory != NULL) {
+      memset(memory, 1, size * MIB); /* private and dirty, as a heap would be */
+    }
+
+    forked = measure(launch_fork, in, launches);
+    spawned = measure(launch_spawn, in, launches);
+    printf("%10ld %12.1f %12.1f\n", size, forked, spawned);
+    fflush(stdout);
+
+    if (memory != NULL) {
+      munmap(memory, size * MIB);
+    }
+  }
+
+  close(in);
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief returns the monotonic time in microseconds
+ */
+static double now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/**
+ * @brief launches the program with fork() and execve()
+ *
+ * @param in the stdin of the child
+ *
+ * @returns the pid of the child or -1 in case of error
+ */
+static pid_t launch_fork(int in) {
+  char *const argv[] = {PROGRAM, NULL};
+  pid_t pid;
+
+  if ((pid = fork()) == 0) {
+    if (dup2(in, STDIN_FILENO) == -1) {
+      _exit(EXIT_FAILURE);
+    }
+    execve(PROGRAM, argv, environ);
+    _exit(EXIT_FAILURE);
+  }
+
+  return pid;
+}
+
+/**
+ * @brief launches the program with posix_spawn()
+ *
+ * @param in the stdin of the child
+ *
+ * @returns the pid of the child or -1 in case of error
+ */
+static pid_t launch_spawn(int in) {
+  char *const argv[] = {PROGRAM, NULL};
+  posix_spawn_file_actions_t actions;
+  pid_t pid;
+
+  if ((errno = posix_spawn_file_actions_init(&actions)) != 0) {
+    return -1;
+  }
+  if ((errno = posix_spawn_file_actions_adddup2(&actions, in, STDIN_FILENO)) != 0 ||
+      (errno = posix_spawn(&pid, PROGRAM, &actions, NULL, argv, environ)) != 0) {
+    pid = -1;
+  }
+  posix_spawn_file_actions_destroy(&actions);
+
+  return pid;
+}
+
+/**
+ * @brief measures the mean time from launching a child until it is reaped
+ *
+ * @param launch the way to launch the child
+ * @param in the stdin of the child
+ * @param launches how many children to launch
+ *
+ * @returns the mean time in microseconds
+ */
+static double measure(pid_t (*launch)(int), int in, long launches) {
+  double start;
+  pid_t pid;
+  long i;
+
+  start = now();
+  for (i = 0; i < launches; i++) {
+    if ((pid = launch(in)) == -1) {
+      err(EXIT_FAILURE, "launch");
+    }
+    if (waitpid(pid, NULL, 0) == -1) {
+      err(EXIT_FAILURE, "waitpid");
+    }
+  }
+
+  return (now() - start) / launches;
+}
@@ -0,0 +1,19 @@
+#!/bin/sh
+#
+# Compares the cost of launching the logic with fork() and execve(), as
+# the exec backend did before, and with posix_spawn(), as exec_logic()
+# does now, while the server has grown to different sizes. Prints the
+# mean time of a launch until the child is reaped in microseconds.
+#
+# usage: spawn_cost.sh [launches [size in MiB...]]
+#
+# The compiler is taken from CC (default cc).
+
+LAUNCHES=${1:-500}
+[ $# -gt 0 ] && shift
+SIZES=${*:-0 64 256 1024}
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+
+${CC:-cc} -O2 -Wall -Wextra -o "$TMP/spawn_cost" "$(dirname "$0")/spawn_cost.c" || exit 1
+"$TMP/spawn_cost" "$LAUNCHES" $SIZES
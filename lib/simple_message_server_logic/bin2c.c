@@ -7,19 +7,26 @@
 // whatever you want with this stuff.  If we meet some day, and you think this stuff is
 // worth it, you can buy me a beer in return.  Sandro Sigala
 //
-// syntax:  bin2c [-c] [-z] <input_file> <output_file>
+// syntax:  bin2c [-c] [-z] [-t] <input_file> <output_file>
 //
 //          -c    add the "const" keyword to definition
 //          -z    terminate the array with a zero (useful for embedded C strings)
+//          -t    deflate a printf() template: the parts between the "%s"
+//                placeholders are compressed one by one as raw deflate data
+//                ending with a sync flush, so the placeholders can be filled
+//                in as stored blocks at runtime; the array is named
+//                <name>_z, the end offsets of the parts are in <name>_z_parts
 //
 // examples:
 //     bin2c -c myimage.png myimage_png.cpp
 //     bin2c -z sometext.txt sometext_txt.cpp
+//     bin2c -c -t sometext.thtml sometext_thtml_z.cpp
  
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <zlib.h>
  
 #ifndef PATH_MAX
 #define PATH_MAX 1024
@@ -27,6 +34,7 @@
  
 int useconst = 0;
 int zeroterminated = 0;
+int deflated = 0;
  
 int myfgetc(FILE *f)
 {
@@ -39,6 +47,87 @@ int myfgetc(FILE *f)
         return c;
 }
  
+void put_bytes(FILE *ofile, const unsigned char *data, size_t len)
+{
+        int col = 1;
+        for (size_t i = 0; i < len; ++i)
+        {
+                if (col >= 78 - 6)
+                {
+                        fputc('\n', ofile);
+                        col = 1;
+                }
+                fprintf(ofile, "0x%.2x, ", data[i]);
+                col += 6;
+        }
+}
+
+void process_template(FILE *ifile, FILE *ofile, const char *name)
+{
+        static unsigned char in[65536], out[65536 + 1024];
+        size_t in_len, out_len = 0, part_len;
+        unsigned long ends[64];
+        size_t parts = 0;
+        unsigned char *part = in, *placeholder;
+        z_stream strm;
+
+        in_len = fread(in, 1, sizeof(in), ifile);
+        if (!feof(ifile))
+        {
+                fprintf(stderr, "template too long\n");
+                exit(1);
+        }
+
+        memset(&strm, 0, sizeof(strm));
+        if (deflateInit2(&strm, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+                fprintf(stderr, "deflateInit2() failed\n");
+                exit(1);
+        }
+
+        do
+        {
+                placeholder = NULL;
+                for (unsigned char *q = part; q + 1 < in + in_len; ++q)
+                {
+                        if (q[0] == '%' && q[1] == 's')
+                        {
+                                placeholder = q;
+                                break;
+                        }
+                }
+                part_len = (placeholder != NULL) ? (size_t) (placeholder - part) : (size_t) (in + in_len - part);
+
+                /* no back references into other parts, the placeholders are filled in between */
+                deflateReset(&strm);
+                strm.next_in = part;
+                strm.avail_in = part_len;
+                strm.next_out = out + out_len;
+                strm.avail_out = sizeof(out) - out_len;
+                if (deflate(&strm, Z_SYNC_FLUSH) != Z_OK || strm.avail_in != 0 || parts == sizeof(ends) / sizeof(*ends))
+                {
+                        fprintf(stderr, "deflate() failed\n");
+                        exit(1);
+                }
+                out_len = sizeof(out) - strm.avail_out;
+                ends[parts++] = out_len;
+
+                part = (placeholder != NULL) ? placeholder + 2 : NULL;
+        } while (part != NULL);
+
+        deflateEnd(&strm);
+
+        fprintf(ofile, "static %sunsigned char %s_z[] = {\n", useconst ? "const " : "", name);
+        put_bytes(ofile, out, out_len);
+        fprintf(ofile, "\n};\n");
+        fprintf(ofile, "static %sunsigned long %s_z_parts[] = {\n", useconst ? "const " : "", name);
+        for (size_t i = 0; i < parts; ++i)
+        {
+                fprintf(ofile, "%lu, ", ends[i]);
+        }
+        fprintf(ofile, "\n};\n");
+}
+
 void process(const char *ifname, const char *ofname)
 {
         FILE *ifile, *ofile;
@@ -71,6 +160,13 @@ void process(const char *ifname, const char *ofname)
           if (!isalnum((int) *p))
                         *p = '_';
         }
+        if (deflated)
+        {
+                process_template(ifile, ofile, buf);
+                fclose(ifile);
+                fclose(ofile);
+                return;
+        }
         fprintf(ofile, "static %sunsigned char %s[] = {\n", useconst ? "const " : "", buf);
         int c, col = 1;
         while ((c = myfgetc(ifile)) != EOF)
@@ -91,7 +187,7 @@ void process(const char *ifname, const char *ofname)
  
 void usage(void)
 {
-        fprintf(stderr, "usage: bin2c [-cz] <input_file> <output_file>\n");
+        fprintf(stderr, "usage: bin2c [-czt] <input_file> <output_file>\n");
         exit(1);
 }
  
@@ -109,6 +205,11 @@ int main(int argc, char **argv)
                         zeroterminated = 1;
                         --argc;
                         ++argv;
+                } else if (!strcmp(argv[1], "-t"))
+                {
+                        deflated = 1;
+                        --argc;
+                        ++argv;
                 } else {
                         usage();
                 }
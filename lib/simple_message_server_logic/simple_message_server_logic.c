@@ -28,6 +28,8 @@
 #include <getopt.h>
 #include <string.h>
 #include <limits.h>
+#include <stdint.h>
+#include <inttypes.h>
 #include <pwd.h>
 #include <errno.h>
 #include <sys/types.h>
@@ -39,32 +41,67 @@
 #include <sys/times.h>
 #include <ctype.h>
 #include <sys/file.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/inotify.h>
+#include <zlib.h>
 
 /*
  * include embedded PNGs and HTML pages.
  */
-#include "vcs_tcpip_bulletin_board.php.h"
+#include "vcs_tcpip_bulletin_board.thtml.h"
 #include "vcs_tcpip_bulletin_board_response_ok.thtml.h"
 #include "vcs_tcpip_bulletin_board_response_error.thtml.h"
+#include "vcs_tcpip_bulletin_board_response_ok.thtml.z.h"
+#include "vcs_tcpip_bulletin_board_response_error.thtml.z.h"
 #include "ok.png.h"
 #include "error.png.h"
 #include "content_entry_with_img.thtml.h"
 #include "content_entry_without_img.thtml.h"
 
+#include "simple_message_server_logic.h"
+
 /*
  * --------------------------------------------------------------- defines --
  */
 
-#define MAXERRORMSG 256
 #define MAXTAGLEN 16
-#define MAXMESSAGELEN 1024
+#define MAXMESSAGELEN SMSL_MAXMESSAGELEN
 #define MAXPATHLEN _POSIX_PATH_MAX
+#define MAXERRORMSG (MAXPATHLEN + 256)  /* room for a path and the text around it */
 #define MAXFILESIZEDIGITS 20
 #define MAXSTATUSDIGITS 10
 #define MAXURLLEN 4096
-
-#define BULLETIN_BOARD_MAIN_FILE "vcs_tcpip_bulletin_board.php"
-#define BULLETIN_BOARD_CONTENT_FILE "bulletin_board_content.dat"
+#define MAXKEYLEN 16
+#define MAXEVENTLEN (sizeof(struct inotify_event) + NAME_MAX + 1)
+#define MAXMANIFESTLEN 512
+#define MAXHEADERLEN (MAXKEYLEN + MAXFILESIZEDIGITS + 2)
+#define HASHLEN 16
+#define MINRECORDLEN 9     /* "record=0\n" */
+#define RECORDOVERHEAD 12  /* "user=", "\n", "img=", "\n" and '\0' */
+
+#define BULLETIN_BOARD_MAIN_FILE "vcs_tcpip_bulletin_board.html"
+#define BULLETIN_BOARD_CONTENT_FILE "bulletin_board_content.dat"  /* of earlier versions */
+#define BULLETIN_BOARD_STORE_DIR "bulletin_board"
+#define STORE_HEAD_FILE "head"
+#define STORE_SEGMENTS_FILE "segments"
+#define STORE_PAGE_FILE "page.%d.html"  /* the two copies of the main page */
+#define STORE_PAGE_LINK "page.html"     /* a copy linked to be renamed over the main page */
+#define SEGMENT_SUFFIX ".log"
+#define INDEX_SUFFIX ".idx"
+#define MAXSEGMENTNAMELEN 32
+#define SEGMENT_SIZE (1024U * 1024U)  /* records of a segment at most, in bytes */
+#define SEGMENT_INDEX_INTERVAL 64     /* records per entry of the index of a segment */
+#define DEFAULT_COMMIT_BATCH 1024  /* records of a group commit at most */
+#define PAGE_ENTRIES 100           /* newest entries on the main page at least */
+#define PAGE_MARKER_FORMAT "<!-- records %020" PRIu64 " %020" PRIu64 " length %020" PRIu64 " -->\n"
+#define PAGE_MARKER_SCAN "<!-- records %" SCNu64 " %" SCNu64 " length %" SCNu64 " -->%n"
+#define PAGE_MARKER_LEN (sizeof("<!-- records " " " " length " " -->\n") - 1 + 3 * MAXFILESIZEDIGITS)
+#define DEFAULT_SYNC_INTERVAL 1000  /* milliseconds from a post to its periodic sync at most */
+#define DEFAULT_PUBLISH_INTERVAL 200  /* milliseconds from a post to the main page showing it at most */
+#define MINENTRYLEN (sizeof(content_entry_without_img_thtml) - 5)  /* rendered without user and message */
 
 #define SMSL_E_OK      0
 #define SMSL_E_FAILED -1  /* a general problem occured */
@@ -74,6 +111,14 @@
 #define CHUNKSIZE 1024U
 #define ADDITIONAL_BLANK_CHUNKS (1024U * 1024U)
 
+/*
+ * How durable a post is when it is acknowledged, set via the
+ * environment variable SMSL_DURABILITY (none, sync or periodic).
+ */
+#define DURABILITY_NONE     0  /* posts are left to the page cache */
+#define DURABILITY_SYNC     1  /* every group commit is synced before it is acknowledged */
+#define DURABILITY_PERIODIC 2  /* posts are synced in the background, see sync_board() */
+
 /*
  * The program supports different tests which can be activated
  * via the environment variable SMSL_TESTCASE. Constants for
@@ -102,10 +147,140 @@ typedef struct
     const char *description;
 } testcase_info_t;
 
+/*
+ * a message to be posted and the status of posting it
+ */
+typedef struct
+{
+    const char *user;
+    const char *img;
+    const char *msg;
+    int status;
+} record_t;
+
+/*
+ * a post waiting in the commit queue, see post_message()
+ */
+typedef struct commit
+{
+    record_t *records;
+    size_t count;
+    int done;                   /* set by the leader which wrote it */
+    int rc;                     /* result of append_records() */
+    char errormsg[MAXERRORMSG]; /* of the leader if it failed */
+    struct commit *next;
+} commit_t;
+
+/*
+ * a response template deflated by "bin2c -t" and the strings filled
+ * in for its placeholders
+ */
+typedef struct
+{
+    const unsigned char *data;  /* the deflated parts */
+    const unsigned long *ends;  /* end offsets of the parts in data */
+    size_t parts;
+    const char * const *args;   /* parts - 1 strings */
+} deflated_t;
+
+/*
+ * the head of the message store, the committed end of the store in
+ * host byte order, see post_message()
+ */
+typedef struct
+{
+    uint64_t segments;  /* entries of the segment table */
+    uint64_t segment;   /* first record of the newest segment */
+    uint64_t count;     /* number of records */
+    uint64_t size;      /* length of the newest segment */
+    int64_t time;       /* time of the newest record */
+} store_head_t;
+
+/*
+ * an entry of the segment table
+ */
+typedef struct
+{
+    uint64_t first;     /* sequence number of the first record */
+    int64_t time;       /* time of the first record */
+} segment_entry_t;
+
+/*
+ * an entry of the index of a segment, for every
+ * SEGMENT_INDEX_INTERVAL-th record from the first one on
+ */
+typedef struct
+{
+    int64_t time;       /* time of the record */
+    uint64_t offset;    /* offset of the record in the segment */
+} index_entry_t;
+
+/*
+ * the header of a record in a segment, followed by the user, the
+ * image URL and the message without terminating zeros
+ */
+typedef struct
+{
+    uint32_t len;       /* length of the record including the header */
+    uint32_t user_len;
+    uint32_t img_len;   /* 0 without image */
+    uint32_t msg_len;
+    int64_t time;       /* seconds since the epoch */
+} record_header_t;
+
+/*
+ * the files of the message store kept open for appending and the
+ * buffer the records of a post are collected in, see append_records()
+ */
+typedef struct
+{
+    pid_t pid;          /* process which opened the files */
+    int head_fd;        /* -1 if not open */
+    int table_fd;       /* -1 if not open */
+    int log_fd;         /* the newest segment, -1 if not open */
+    int idx_fd;         /* the index of the newest segment */
+    uint64_t segment;   /* first record of the newest segment */
+    uint64_t segments;  /* segments of the store before the last post */
+    char *buf;
+    size_t size;        /* size of buf */
+} appender_t;
+
+/*
+ * a reader of the message store, see seek_record()
+ */
+typedef struct
+{
+    store_head_t head;  /* read when the store was locked */
+    int lock_fd;        /* the head file, -1 for an empty store */
+    int table_fd;       /* the segment table */
+    int log_fd;         /* the segment being read */
+    uint64_t segment;   /* index of the segment in the segment table */
+    uint64_t first;     /* first record of the segment */
+    uint64_t end;       /* record following the segment */
+    uint64_t seq;       /* next record */
+    uint64_t offset;    /* offset of the next record in the segment */
+    char *buf;          /* fields of the record */
+    size_t size;        /* size of buf */
+} store_reader_t;
+
+/*
+ * a file of the response, see download_file() for the members
+ */
+typedef struct
+{
+    const char *name;
+    const void *buf;
+    size_t len;
+    unsigned blank_chunks;
+    int cacheable;
+    const deflated_t *deflated;
+} file_t;
+
 /*
  * --------------------------------------------------------------- globals --
  */
 
+#ifndef SMSL_LIBRARY
 const testcase_info_t testcase_info[] =
 {
     {
@@ -145,6 +320,7 @@ const testcase_info_t testcase_info[] =
         "send a really huge html file for the response"
     }
 };
+#endif /* SMSL_LIBRARY */
 
 /*
  * selected test case
@@ -162,9 +338,10 @@ static const char * const allowed_tags[] =
 };
 
 /*
- * error message that will be sent to client
+ * error message that will be sent to client (per thread, as several
+ * threads of the server may process requests at the same time)
  */
-static char errormsg[MAXERRORMSG];
+static __thread char errormsg[MAXERRORMSG];
 
 /*
  * chunks of blank bytes
@@ -176,10 +353,150 @@ static char chunk_of_blanks[CHUNKSIZE];
  */
 static const char *cmd = "<not yet set>";
 
+/*
+ * file descriptors the client request is read from and the response
+ * is written to (stdin and stdout when executed by the spawning
+ * server, the connected socket when linked into the server)
+ */
+static __thread int in_fd = STDIN_FILENO;
+static __thread int out_fd = STDOUT_FILENO;
+
+/*
+ * time a client may take to send a request and to receive the
+ * responses, as set on the socket by the spawning server (zero if
+ * unlimited), and the points in time (CLOCK_MONOTONIC) these end for
+ * the request being read and the responses being written
+ */
+static __thread struct timeval recv_timeout;
+static __thread struct timeval send_timeout;
+static __thread struct timespec recv_deadline;
+static __thread struct timespec send_deadline;
+
+/*
+ * buffer the response is collected in instead of writing it to
+ * out_fd (used by event driven servers, NULL otherwise)
+ */
+static __thread smsl_buffer_t *out_buf = NULL;
+
+/*
+ * protocol version of the request being answered
+ */
+static __thread int version = 1;
+
+/*
+ * hashes of the files cached by the client of the request being
+ * answered, separated by blanks (NULL if the client has no cache)
+ */
+static __thread const char *cached = NULL;
+static __thread size_t cached_len = 0;
+
+/*
+ * set if the client of the request being answered accepts files
+ * compressed with deflate
+ */
+static __thread int deflate_ok = 0;
+
+/*
+ * set if the client of the request being answered asks for a manifest
+ * of the files ahead of them
+ */
+static __thread int manifest_ok = 0;
+
+/*
+ * set if the client of the request being answered asks for the
+ * durability of its posts, and the durability they reached, NULL if
+ * nothing was posted
+ */
+static __thread int durability_ok = 0;
+static __thread const char *durability_level = NULL;
+
+/*
+ * watch of the bulletin board while a subscribe request of the
+ * connection served by serve_connection() waits, -1 if none
+ */
+static __thread int board_watch = -1;
+
+/*
+ * write responses in chunks of random size (see write_in_chunks())
+ */
+static int random_chunks = 0;
+
+/*
+ * URL of the bulletin board web page and the user's home directory,
+ * determined once by smsl_init()
+ */
+static char url[MAXURLLEN];
+static char homedir[MAXPATHLEN];
+
+/*
+ * 0 if the main page exists, -1 if its creation failed
+ */
+static int mainpagecreated = -1;
+
+/*
+ * the posts of all threads waiting to be committed (see post_message())
+ * and the number of their records, set while a leader commits a group
+ */
+static pthread_mutex_t commit_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t commit_cond = PTHREAD_COND_INITIALIZER;
+static commit_t *commit_queue = NULL;
+static commit_t **commit_tail = &commit_queue;
+static size_t commit_queued = 0;
+static int commit_leading = 0;
+
+/*
+ * microseconds a leader waits for more posts to join its group, the
+ * records of a group at most, the durability of the posts, the
+ * milliseconds until they are synced with DURABILITY_PERIODIC and until
+ * the main page shows them, set from the environment variables
+ * SMSL_COMMIT_WINDOW, SMSL_COMMIT_BATCH, SMSL_DURABILITY,
+ * SMSL_SYNC_INTERVAL and SMSL_PUBLISH_INTERVAL
+ */
+static long commit_window = 0;
+static size_t commit_batch = DEFAULT_COMMIT_BATCH;
+static int durability = DURABILITY_NONE;
+static long sync_interval = DEFAULT_SYNC_INTERVAL;
+static long publish_interval = DEFAULT_PUBLISH_INTERVAL;
+
+/*
+ * the values of SMSL_DURABILITY, as reported to the clients, indexed
+ * by DURABILITY_NONE, DURABILITY_SYNC and DURABILITY_PERIODIC
+ */
+static const char * const durability_names[] = { "none", "sync", "periodic" };
+
+/*
+ * with DURABILITY_PERIODIC: set by a commit, cleared by the sync of the
+ * store, the segments of the store before the first commit of this
+ * process since the last sync, the newest of which has grown since
+ * (guarded by commit_mutex and signalled with sync_cond), the process
+ * the syncer thread runs in and the lock serializing the syncs
+ */
+static int store_dirty = 0;
+static uint64_t dirty_segments = 0;
+static pthread_cond_t sync_cond = PTHREAD_COND_INITIALIZER;
+static pid_t syncer_pid = 0;
+static pthread_mutex_t sync_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * set by a commit, cleared when the main page is published (guarded by
+ * commit_mutex and signalled with publish_cond), and the process the
+ * publisher thread runs in
+ */
+static int page_stale = 0;
+static pthread_cond_t publish_cond = PTHREAD_COND_INITIALIZER;
+static pid_t publisher_pid = 0;
+
+/*
+ * the appender of the message store, used by the leader of a group
+ * commit only (see lead_commit())
+ */
+static appender_t appender = { 0, -1, -1, -1, -1, 0, 0, NULL, 0 };
+
 /*
  * ------------------------------------------------------------- functions --
  */
 
+#ifndef SMSL_LIBRARY
 /**
  * \brief Print a usage message
  *
@@ -199,10 +516,22 @@ static void usage(
         fp,
         "usage: %s option\n"
         "options:\n"
+        "\t-p, --pool\n"
         "\t-h, --help\n\n"
+        "Concurrent posts are committed in groups, configured with the\n"
+        "environment variables SMSL_COMMIT_WINDOW (microseconds to wait\n"
+        "for a group, default 0), SMSL_COMMIT_BATCH (records of a group\n"
+        "at most, default %d) and SMSL_DURABILITY: none (default), sync\n"
+        "(every group is synced before it is acknowledged) or periodic\n"
+        "(posts are synced in the background within SMSL_SYNC_INTERVAL\n"
+        "milliseconds, default %d). The main page shows new posts within\n"
+        "SMSL_PUBLISH_INTERVAL milliseconds (default %d).\n\n"
         "This program can perform several tests, which can be choosen\n"
         "with the environment variable SMSL_TESTCASE:\n",
-	cmd
+	cmd,
+        DEFAULT_COMMIT_BATCH,
+        DEFAULT_SYNC_INTERVAL,
+        DEFAULT_PUBLISH_INTERVAL
         );
 
     for (i = 0; i < (sizeof(testcase_info)/sizeof(*testcase_info)); i++)
@@ -222,6 +551,93 @@ static void usage(
 
     exit(exit_code);
 }
+#endif /* SMSL_LIBRARY */
+
+/**
+ * \brief Get the options of the group commit from the environment
+ *
+ * SMSL_COMMIT_WINDOW sets \a commit_window (microseconds, default 0),
+ * SMSL_COMMIT_BATCH \a commit_batch (records, default
+ * DEFAULT_COMMIT_BATCH), SMSL_DURABILITY \a durability ("none",
+ * "sync" or "periodic", default "none"), SMSL_SYNC_INTERVAL
+ * \a sync_interval (milliseconds, default DEFAULT_SYNC_INTERVAL) and
+ * SMSL_PUBLISH_INTERVAL \a publish_interval (milliseconds, default
+ * DEFAULT_PUBLISH_INTERVAL).
+ *
+ * \retval 0 success
+ * \retval -1 a variable is not valid
+ */
+static int get_commit_options(
+    void
+    )
+{
+    static const char * const names[] = {
+        "SMSL_COMMIT_WINDOW", "SMSL_COMMIT_BATCH", "SMSL_SYNC_INTERVAL", "SMSL_PUBLISH_INTERVAL"
+    };
+    static const long min[] = { 0, 1, 1, 1 };
+    static const long max[] = { 10000000, LONG_MAX, 3600000, 3600000 };
+    long values[sizeof(names) / sizeof(*names)];
+    const char *s;
+    char *eptr;
+    size_t i;
+
+    values[0] = commit_window;
+    values[1] = (long) commit_batch;
+    values[2] = sync_interval;
+    values[3] = publish_interval;
+
+    for (i = 0; i < sizeof(names) / sizeof(*names); i++)
+    {
+        if ((s = getenv(names[i])) == NULL)
+        {
+            continue;
+        }
+
+        errno = 0;
+        values[i] = strtol(s, &eptr, 10);
+        if (errno != 0 || *s == '\0' || *eptr != '\0'
+            || values[i] < min[i] || values[i] > max[i])
+        {
+            (void) fprintf(
+                stderr,
+                "%s: %s: invalid value of %s.\n",
+	        cmd,
+	        __func__,
+	        names[i]
+                );
+            return -1;
+        }
+    }
+
+    if ((s = getenv("SMSL_DURABILITY")) != NULL)
+    {
+        for (i = 0; i < sizeof(durability_names) / sizeof(*durability_names); i++)
+        {
+            if (strcmp(s, durability_names[i]) == 0)
+            {
+                break;
+            }
+        }
+        if (i == sizeof(durability_names) / sizeof(*durability_names))
+        {
+            (void) fprintf(
+                stderr,
+                "%s: %s: invalid value of SMSL_DURABILITY.\n",
+	        cmd,
+	        __func__
+                );
+            return -1;
+        }
+        durability = (int) i;
+    }
+
+    commit_window = values[0];
+    commit_batch = (size_t) values[1];
+    sync_interval = values[2];
+    publish_interval = values[3];
+
+    return 0;
+}
 
 /**
  * \brief Set seed for random number generator
@@ -254,6 +670,7 @@ static int get_random_max(
     return ((random() % max) + 1);
 }
 
+#ifndef SMSL_LIBRARY
 /**
  * \brief Get the number of the testcase to be executed
  *
@@ -328,6 +745,7 @@ static void assert_files_closed(
 
     (void) fprintf(stderr, "Test 2 passed\n");
 }
+#endif /* SMSL_LIBRARY */
 
 /**
  * \brief Get the URL for the bulletin board web page and the home directory
@@ -339,8 +757,11 @@ static void assert_files_closed(
  * \param url_len size of the buffer pointed to by \a url [IN]
  * \param homedir pointer to buffer to be filled with the path to the user's home dir [IN]
  * \param homedir_len size of the buffer pointed to by \a homedir [IN]
+ *
+ * \retval 0 success
+ * \retval -1 URL or home directory could not be determined
  */
-static void get_url_and_homedir(
+static int get_url_and_homedir(
     char *url,
     size_t url_len,
     char *homedir,
@@ -361,7 +782,7 @@ static void get_url_and_homedir(
 	    __func__,
 	    strerror(errno)
 	    );
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
     if (gethostname(host, sizeof(host) - 1) == -1)
@@ -373,7 +794,7 @@ static void get_url_and_homedir(
 	    __func__,
 	    strerror(errno)
 	    );
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
     host[sizeof(host) - 1] = 0;
@@ -396,7 +817,7 @@ static void get_url_and_homedir(
 	    __func__,
 	    strerror(errno)
 	    );
-        exit(EXIT_FAILURE);
+        return -1;
     }
     else if ((size_t) cnt >= url_len)
     {
@@ -406,7 +827,7 @@ static void get_url_and_homedir(
 	    cmd,
 	    __func__
             );
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
     if (strlen(pw->pw_dir) >= homedir_len)
@@ -417,20 +838,25 @@ static void get_url_and_homedir(
 	    cmd,
 	    __func__
             );
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
     strncpy(homedir, pw->pw_dir, homedir_len - 1);
     homedir[homedir_len - 1] = 0; /* force string termination */
+
+    return 0;
 }
 
 /**
- * \brief Turn off the nagle algorithm on stdout
+ * \brief Turn off the nagle algorithm on the output descriptor
+ *
+ * Check whether the output descriptor of the connection is actually a
+ * socket and if so, turn off the nagle algorithm on that socket.
  *
- * Check whether stdout is actually a socket and if so, turn off the
- * nagle algorithm on that socket.
+ * \retval 0 success
+ * \retval -1 failed
  */
-static void turn_off_nagle_algorithm(
+static int turn_off_nagle_algorithm(
     void
     )
 {
@@ -438,10 +864,10 @@ static void turn_off_nagle_algorithm(
     int yes = 1;
 
     /*
-     * Check if stdout is a socket. If not we can omit the
-     * setsockopt() call to turn off the Nagle algorithm.
+     * Check if the output descriptor is a socket. If not we can omit
+     * the setsockopt() call to turn off the Nagle algorithm.
      */
-    if (fstat(STDOUT_FILENO, &statbuf) == -1)
+    if (fstat(out_fd, &statbuf) == -1)
     {
 	(void) fprintf(
 	    stderr,
@@ -450,16 +876,16 @@ static void turn_off_nagle_algorithm(
 	    __func__,
 	    strerror(errno)
 	    );
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
     if (!S_ISSOCK(statbuf.st_mode))
     {
-        return;  /* no socket */
+        return 0;  /* no socket */
     }
 
     if (setsockopt(
-            STDOUT_FILENO, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes)
+            out_fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes)
             ) == -1)
     {
 	(void) fprintf(
@@ -469,15 +895,117 @@ static void turn_off_nagle_algorithm(
 	    __func__,
 	    strerror(errno)
 	    );
-        exit(EXIT_FAILURE);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Get the timeouts the spawning server set on the connection
+ *
+ * The server limits every single read and write with SO_RCVTIMEO and
+ * SO_SNDTIMEO. They are turned into deadlines for a whole request and
+ * its responses, so a client trickling in a byte at a time cannot hold
+ * the connection forever. Descriptors which are no sockets have none.
+ */
+static void get_timeouts(
+    void
+    )
+{
+    socklen_t optlen = sizeof(struct timeval);
+
+    if (getsockopt(in_fd, SOL_SOCKET, SO_RCVTIMEO, &recv_timeout, &optlen) == -1)
+    {
+        memset(&recv_timeout, 0, sizeof(recv_timeout));
+    }
+
+    optlen = sizeof(struct timeval);
+    if (getsockopt(out_fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, &optlen) == -1)
+    {
+        memset(&send_timeout, 0, sizeof(send_timeout));
+    }
+}
+
+/**
+ * \brief Start the time a client may take for a request or its responses
+ *
+ * \param timeout the time the client may take, zero if unlimited [IN]
+ * \param deadline the point in time it ends, zero if never [OUT]
+ */
+static void arm_deadline(
+    const struct timeval *timeout,
+    struct timespec *deadline
+    )
+{
+    memset(deadline, 0, sizeof(*deadline));
+
+    if (timeout->tv_sec == 0 && timeout->tv_usec == 0)
+    {
+        return;
+    }
+
+    (void) clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += timeout->tv_sec;
+    deadline->tv_nsec += timeout->tv_usec * 1000;
+    if (deadline->tv_nsec >= 1000000000)
+    {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+}
+
+/**
+ * \brief Limit the next read or write to what is left until a deadline
+ *
+ * \param fd the socket [IN]
+ * \param option SO_RCVTIMEO or SO_SNDTIMEO [IN]
+ * \param deadline the point in time the limit ends, zero if never [IN]
+ *
+ * \retval 0 success
+ * \retval -1 the deadline has passed or setsockopt() failed
+ */
+static int limit_to_deadline(
+    int fd,
+    int option,
+    const struct timespec *deadline
+    )
+{
+    struct timespec now;
+    struct timeval left;
+    long long nsec;
+
+    if (deadline->tv_sec == 0 && deadline->tv_nsec == 0)
+    {
+        return 0;
     }
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &now);
+    nsec = (long long) (deadline->tv_sec - now.tv_sec) * 1000000000LL
+        + (deadline->tv_nsec - now.tv_nsec);
+    if (nsec < 1000)
+    {
+        return -1;
+    }
+
+    left.tv_sec = (time_t) (nsec / 1000000000LL);
+    left.tv_usec = (suseconds_t) (nsec % 1000000000LL / 1000);
+
+    return setsockopt(fd, SOL_SOCKET, option, &left, sizeof(left));
 }
 
+/*
+ * defined with the readers of the message store
+ */
+static int publish_page(void);
+
 /**
  * \brief Create main bulletin board web page
  *
  * Create main bulletin board web page in users public_html directory
- * in case it does not exist.
+ * in case it does not exist, or bring it up to date with the posts a
+ * killed process has not published. It is kept up to date by the
+ * publisher (see \a publish_board()).
  *
  * \param homedir zero-terminated string with the path of the user's home directory [IN]
  *
@@ -490,7 +1018,6 @@ static int create_main_page(
 {
     char file[MAXPATHLEN];
     int cnt;
-    int fd;
 
     cnt = snprintf(
 	file,
@@ -509,7 +1036,7 @@ static int create_main_page(
 	    __func__,
 	    strerror(errno)
 	    );
-        exit(EXIT_FAILURE);
+        return -1;
     }
     else if ((size_t) cnt >= sizeof(file))
     {
@@ -519,63 +1046,72 @@ static int create_main_page(
 	    cmd,
 	    __func__
 	    );
-        exit(EXIT_FAILURE);
-    }
-
-    if ((fd = open(file, O_RDWR | O_CREAT | O_EXCL, 0644)) == -1)
-    {
-        if ((errno == EEXIST))
-	{
-            return 0;
-                /* the file already exists. nothing to do. */
-        }
-        else {
-	    (void) fprintf(
-		stderr,
-		"%s: %s: Creation of %s failed - %s.\n",
-		cmd,
-		__func__,
-		file,
-		strerror(errno)
-		);
-            return -1;
-        }
+        return -1;
     }
 
-    if (
-	write(
-            fd,
-	    vcs_tcpip_bulletin_board_php,
-            sizeof(vcs_tcpip_bulletin_board_php)
-            ) != sizeof(vcs_tcpip_bulletin_board_php)
-	)
+    if (publish_page() == -1)
     {
-        (void) fprintf(
-            stderr,
-            "%s: %s: write to %s failed - %s.\n",
+	(void) fprintf(
+	    stderr,
+	    "%s: %s: Creation of %s failed - %s",
 	    cmd,
 	    __func__,
-            file,
-	    strerror(errno)
-            );
-        (void) close(fd);
-        (void) unlink(file);
+	    file,
+	    errormsg
+	    );
         return -1;
     }
 
-    if (close(fd) == -1)
-    {
-        (void) fprintf(
-            stderr,
-            "%s: %s: close of %s failed - %s.\n",
-	    cmd,
-	    __func__,
-            file,
-	    strerror(errno)
-            );
-	return -1;
+    return 0;
+}
+
+/**
+ * \brief Append to the response buffer
+ *
+ * Append \a len bytes from \a buf to the response buffer \a out_buf,
+ * growing it if necessary.
+ *
+ * \param buf pointer to the bytes to append [IN]
+ * \param len number of bytes to append [IN]
+ *
+ * \retval 0 success
+ * \retval -1 out of memory
+ */
+static int append_to_buffer(
+    const void *buf,
+    size_t len
+    )
+{
+    size_t size;
+    char *data;
+
+    if (out_buf->len + len > out_buf->size)
+    {
+        size = (out_buf->size != 0) ? out_buf->size : CHUNKSIZE;
+        while (size < out_buf->len + len)
+        {
+            size *= 2;
+        }
+
+        if ((data = realloc(out_buf->data, size)) == NULL)
+        {
+	    (void) fprintf(
+		stderr,
+		"%s: %s: realloc() failed - %s.\n",
+		cmd,
+		__func__,
+		strerror(errno)
+		);
+            return -1;
+        }
+
+        out_buf->data = data;
+        out_buf->size = size;
     }
 
+    memcpy(out_buf->data + out_buf->len, buf, len);
+    out_buf->len += len;
+
     return 0;
 }
 
@@ -586,11 +1122,18 @@ static int create_main_page(
  * size to enforce short reads on the client side. In case
  * SMSL_TESTCASE is set to the numeric value of TESTCASE_WRITE_DELAY,
  * introduce 0.2 seconds delay between the writing of each chunk.
+ * Unless \a random_chunks is set (i.e., when linked into the server),
+ * the buffer is written with as few write() calls as possible, none of
+ * them beyond the deadline of the responses. If \a out_buf is set, the
+ * buffer is appended to it instead.
  *
  * \param buf pointer to the buffer to write [IN]
  * \param len length to the buffer pointed to by \a buf [IN]
+ *
+ * \retval 0 success
+ * \retval -1 write failed
  */
-static void write_in_chunks(
+static int write_in_chunks(
     const void *buf,
     size_t len
     )
@@ -598,10 +1141,32 @@ static void write_in_chunks(
     const char *b = (const char *) buf;
     ssize_t cnt;
 
+    if (out_buf != NULL)
+    {
+        return append_to_buffer(buf, len);
+    }
+
     while (len)
     {
-        if ((cnt = write(STDOUT_FILENO, b, get_random_max(len))) == -1)
+        if (limit_to_deadline(out_fd, SO_SNDTIMEO, &send_deadline) == -1)
+        {
+	    (void) fprintf(
+		stderr,
+		"%s: %s: the client did not take the response in time.\n",
+		cmd,
+		__func__
+		);
+            return -1;
+        }
+
+        if ((cnt = write(
+                 out_fd, b, random_chunks ? (size_t) get_random_max(len) : len
+                 )) == -1)
         {
+            if (errno == EINTR)
+            {
+                continue;
+            }
 	    (void) fprintf(
 		stderr,
 		"%s: %s: write() failed - %s.\n",
@@ -609,8 +1174,8 @@ static void write_in_chunks(
 		__func__,
 		strerror(errno)
 		);
-	    /* error response will fail too, thus just exit. */
-            exit(EXIT_FAILURE);
+	    /* error response will fail too, thus just give up. */
+            return -1;
         }
 
         len -= cnt;
@@ -621,23 +1186,37 @@ static void write_in_chunks(
             usleep(200000);
 	}
     }
+
+    return 0;
 }
 
 /**
  * \brief Write execution status of business logic
  *
  * Write the provided execution status (\a status) of the business
- * logic to stdout using \a write_in_chunks().
+ * logic to the client using \a write_in_chunks(). If the client asked
+ * for it and the request posted messages, their durability follows.
  *
  * \param status execution status of the business logic [IN]
+ *
+ * \retval 0 success
+ * \retval -1 failed
  */
-static void write_status(int status)
+static int write_status(int status)
 {
     static const char * const fmt_status = "status=%d\n";
-    char s[MAXSTATUSDIGITS + sizeof(fmt_status)];
+    static const char * const fmt_durability = "status=%d\ndurability=%s\n";
+    char s[2 * MAXHEADERLEN];
     int cnt;
 
-    cnt = snprintf(s, sizeof(s), fmt_status, status);
+    if (durability_ok && durability_level != NULL)
+    {
+        cnt = snprintf(s, sizeof(s), fmt_durability, status, durability_level);
+    }
+    else
+    {
+        cnt = snprintf(s, sizeof(s), fmt_status, status);
+    }
 
     if (cnt < 0)
     {
@@ -648,7 +1227,7 @@ static void write_status(int status)
 	    __func__,
 	    strerror(errno)
             );
-        exit(EXIT_FAILURE);
+        return -1;
     }
     else if ((size_t) cnt >= sizeof(s))
     {
@@ -658,17 +1237,205 @@ static void write_status(int status)
 	    cmd,
 	    __func__
             );
-        exit(EXIT_FAILURE);
+        return -1;
+    }
+
+    return write_in_chunks(s, strlen(s));
+}
+
+/**
+ * \brief Write the number of files of the response
+ *
+ * Version 2 responses announce the number of files following the
+ * status, so the client knows where the response ends without waiting
+ * for the connection to be closed. Nothing is written for version 1.
+ *
+ * \param files number of files [IN]
+ *
+ * \retval 0 success
+ * \retval -1 failed
+ */
+static int write_file_count(
+    size_t files
+    )
+{
+    static const char * const fmt_files = "files=%zu\n";
+    char s[MAXSTATUSDIGITS + sizeof(fmt_files)];
+
+    if (version < 2)
+    {
+        return 0;
+    }
+
+    (void) snprintf(s, sizeof(s), fmt_files, files);
+
+    return write_in_chunks(s, strlen(s));
+}
+
+/**
+ * \brief Hash the contents of a file
+ *
+ * The 64 bit FNV-1a hash of the contents identifies a file in the
+ * cache of the client. It is not meant to resist deliberate collisions,
+ * the client trusts the server anyway.
+ *
+ * \param buf pointer to the contents [IN]
+ * \param len length of the contents [IN]
+ *
+ * \return the hash
+ */
+static unsigned long long hash_file(
+    const void *buf, size_t len
+    )
+{
+    const unsigned char *p = buf;
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ p[i]) * 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+/**
+ * \brief Check whether the client has a file cached
+ *
+ * \param hash zero-terminated hash of the file, as hexadecimal digits [IN]
+ *
+ * \retval 1 the hash is in the list the client sent with its request
+ * \retval 0 otherwise
+ */
+static int is_cached(
+    const char *hash
+    )
+{
+    size_t pos, end;
+
+    for (pos = 0; pos < cached_len; pos = end + 1)
+    {
+        for (end = pos; end < cached_len && cached[end] != ' '; end++)
+        {
+            ;
+        }
+
+        if (end - pos == HASHLEN && memcmp(cached + pos, hash, HASHLEN) == 0)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Get the length of a deflated template
+ *
+ * \param deflated the template and the strings to fill in [IN]
+ *
+ * \return the length of the zlib stream written by \a write_deflated()
+ */
+static size_t deflated_length(
+    const deflated_t *deflated
+    )
+{
+    size_t len = 2 + deflated->ends[deflated->parts - 1] + 6;
+
+    for (size_t i = 0; i + 1 < deflated->parts; i++)
+    {
+        size_t arg_len = strlen(deflated->args[i]);
+
+        len += arg_len + 5 * ((arg_len + 0xffff - 1) / 0xffff);
+    }
+
+    return len;
+}
+
+/**
+ * \brief Write a deflated template
+ *
+ * The parts of the template were compressed at build time, each ending
+ * on a byte boundary. The strings are filled in between as stored
+ * blocks, so nothing is compressed at runtime. The zlib header, an
+ * empty final block and the checksum complete the stream.
+ *
+ * \param deflated the template and the strings to fill in [IN]
+ * \param buf the uncompressed contents, for the checksum [IN]
+ * \param len length of the uncompressed contents [IN]
+ *
+ * \retval 0 success
+ * \retval -1 failed
+ */
+static int write_deflated(
+    const deflated_t *deflated, const void *buf, size_t len
+    )
+{
+    static const unsigned char header[] = { 0x78, 0x01 };
+    unsigned char trailer[] = { 0x03, 0x00, 0, 0, 0, 0 };
+    unsigned char stored[5];
+    unsigned long adler;
+    unsigned long start = 0;
+
+    adler = adler32(adler32(0L, Z_NULL, 0), buf, (uInt) len);
+
+    if (write_in_chunks(header, sizeof(header)) == -1)
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < deflated->parts; i++)
+    {
+        if (write_in_chunks(deflated->data + start, deflated->ends[i] - start) == -1)
+        {
+            return -1;
+        }
+        start = deflated->ends[i];
+
+        if (i + 1 == deflated->parts)
+        {
+            break;
+        }
+
+        const char *arg = deflated->args[i];
+        size_t arg_len = strlen(arg);
+
+        while (arg_len > 0)
+        {
+            size_t n = (arg_len < 0xffff) ? arg_len : 0xffff;
+
+            /*
+             * stored block: header bits (not final), LEN and NLEN
+             */
+            stored[0] = 0;
+            stored[1] = n & 0xff;
+            stored[2] = (n >> 8) & 0xff;
+            stored[3] = ~stored[1];
+            stored[4] = ~stored[2];
+
+            if (write_in_chunks(stored, sizeof(stored)) == -1
+                || write_in_chunks(arg, n) == -1)
+            {
+                return -1;
+            }
+            arg += n;
+            arg_len -= n;
+        }
     }
 
-    write_in_chunks(s, strlen(s));
+    trailer[2] = (adler >> 24) & 0xff;
+    trailer[3] = (adler >> 16) & 0xff;
+    trailer[4] = (adler >> 8) & 0xff;
+    trailer[5] = adler & 0xff;
+
+    return write_in_chunks(trailer, sizeof(trailer));
 }
 
 /**
  * \brief Write file header and file content
  *
  * Write the file header for the file \a filename of length \a len to
- * stdout using \a write_in_chunks(). The contents of the file are
+ * the client using \a write_in_chunks(). The contents of the file are
  * provided in the buffer pointed to by \a buf.
  *
  * \param filename name of the file to be written [IN]
@@ -676,27 +1443,81 @@ static void write_status(int status)
  * \param len length of the file (and thus size of the buffer) [IN]
  * \param additional_blank_chunks additional chunks of blanks to be
  * added at then end of the HTML file [IN]
+ * \param cacheable set if the contents of the file are the same in
+ * every response, so clients with a cache are sent its hash as
+ * "hash=<hash>\n" before "len", or just "cached=<hash>\n" instead of
+ * "len" and the contents if they have it already [IN]
+ * \param deflated the file as deflated template, sent instead of the
+ * contents to clients accepting deflate, or NULL [IN]
+ *
+ * \retval 0 success
+ * \retval -1 failed
  */
-static void download_file(
+static int download_file(
     const char *filename, const void *buf, size_t len,
-    unsigned additional_blank_chunks
+    unsigned additional_blank_chunks, int cacheable,
+    const deflated_t *deflated
     )
 {
-    static const char * const fmt_file = "file=%s\nlen=%zu\n";
-    char s[MAXFILESIZEDIGITS + MAXPATHLEN + sizeof(fmt_file)];
+    static const char * const fmt_file = "file=%s\n%slen=%zu\n";
+    static const char * const fmt_hashed = "file=%s\nhash=%s\n%slen=%zu\n";
+    static const char * const fmt_cached = "file=%s\ncached=%s\n";
+    static const char * const encoding = "encoding=deflate\n";
+    char s[MAXFILESIZEDIGITS + MAXPATHLEN + HASHLEN + 48];
+    char hash[HASHLEN + 1];
+    size_t body_len = len;
     int cnt;
 
-    /*
-     * create header containing keywords "file" and "len".
-     */
-    cnt = snprintf(
-	s,
-	sizeof(s),
-	fmt_file,
-	filename,
-	(testcase == TESTCASE_SMALLER_LENGTH) ? (len - len/3) :
-	len
-	);
+    if (deflated != NULL && deflate_ok && testcase == TESTCASE_NONE)
+    {
+        body_len = deflated_length(deflated);
+    }
+    else
+    {
+        deflated = NULL;
+    }
+
+    if (cacheable && cached != NULL && buf != NULL && testcase == TESTCASE_NONE)
+    {
+        (void) snprintf(hash, sizeof(hash), "%016llx", hash_file(buf, len));
+
+        if (is_cached(hash))
+        {
+            /*
+             * the client has the file, just refer to it
+             */
+            cnt = snprintf(s, sizeof(s), fmt_cached, filename, hash);
+        }
+        else
+        {
+            cnt = snprintf(
+                s,
+                sizeof(s),
+                fmt_hashed,
+                filename,
+                hash,
+                (deflated != NULL) ? encoding : "",
+                body_len
+                );
+        }
+    }
+    else
+    {
+        cacheable = 0;
+
+        /*
+         * create header containing keywords "file" and "len".
+         */
+        cnt = snprintf(
+	    s,
+	    sizeof(s),
+	    fmt_file,
+	    filename,
+	    (deflated != NULL) ? encoding : "",
+	    (testcase == TESTCASE_SMALLER_LENGTH) ? (len - len/3) :
+	    body_len
+	    );
+    }
 
     if (cnt < 0)
     {
@@ -707,7 +1528,7 @@ static void download_file(
 	    __func__,
 	    strerror(errno)
             );
-        exit(EXIT_FAILURE);
+        return -1;
     }
     else if ((size_t) cnt >= sizeof(s))
     {
@@ -717,13 +1538,21 @@ static void download_file(
 	    cmd,
 	    __func__
             );
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
     /*
      * write header with keywords "file" and "len"
      */
-    write_in_chunks(s, strlen(s));
+    if (write_in_chunks(s, strlen(s)) == -1)
+    {
+        return -1;
+    }
+
+    if (cacheable && is_cached(hash))
+    {
+        return 0;
+    }
 
     /*
      * in case we want to simulate a "connection closed by peer"
@@ -735,12 +1564,22 @@ static void download_file(
         len /= 2;
     }
 
-    if (buf != NULL)
+    if (deflated != NULL)
+    {
+        if (write_deflated(deflated, buf, len) == -1)
+        {
+            return -1;
+        }
+    }
+    else if (buf != NULL)
     {
 	/*
 	 * write content of file
 	 */
-	write_in_chunks(buf, len);
+	if (write_in_chunks(buf, len) == -1)
+	{
+	    return -1;
+	}
     }
 
     /*
@@ -752,7 +1591,7 @@ static void download_file(
 	for (unsigned i = 0; i < additional_blank_chunks; ++i)
 	{
 	    (void) fprintf(stderr, "Writing chunk %u of %u ...\n", i, additional_blank_chunks); 
-	    if (write(STDOUT_FILENO, chunk_of_blanks, sizeof(chunk_of_blanks)) == -1)
+	    if (write(out_fd, chunk_of_blanks, sizeof(chunk_of_blanks)) == -1)
 	    {
 		(void) fprintf(
 		    stderr,
@@ -761,106 +1600,237 @@ static void download_file(
 		    __func__,
 		    strerror(errno)
 		    );
-		/* error response will fail too, thus just exit. */
-		exit(EXIT_FAILURE);
+		/* error response will fail too, thus just give up. */
+		return -1;
 	    }
 	}
     }
+
+    return 0;
 }
 
 /**
- * \brief Write an error response
+ * \brief Write the manifest of the files of the response
  *
- * Write an error response as answer to the client's request to
- * stdout using \a write_status() and \a download_file().
+ * A version 2 client asking for it with the field "manifest" gets the
+ * names and lengths of all files whose contents follow, before the
+ * first of them, as "manifest=<length>\n" followed by a line
+ * "<length> <name>\n" per file. The length is the one of the file
+ * as stored by the client, i.e. inflated. Files only referred to as
+ * cached are not listed.
  *
- * \param status execution status of the business logic [IN]
+ * \param files the files of the response [IN]
+ * \param count number of files [IN]
+ *
+ * \retval 0 success
+ * \retval -1 failed
  */
-static void error_response(
-    int status
+static int write_manifest(
+    const file_t *files,
+    size_t count
     )
 {
+    static const char * const fmt_manifest = "manifest=%zu\n";
+    static const char * const fmt_entry = "%zu %s\n";
+    char entries[MAXMANIFESTLEN];
+    char s[MAXFILESIZEDIGITS + sizeof(fmt_manifest)];
+    char hash[HASHLEN + 1];
+    size_t pos = 0;
+    size_t i;
     int cnt;
-    size_t len;
-
-    len = sizeof(vcs_tcpip_bulletin_board_response_error_thtml)
-            + strlen(errormsg);
-
-    char html_response[len];
-
-    /*
-     * encode error message
-     */
-    cnt = snprintf(
-        html_response,
-	len,
-        (const char *) vcs_tcpip_bulletin_board_response_error_thtml,
-        errormsg
-        );
 
-    if (cnt < 0)
+    if (!manifest_ok || version < 2 || testcase != TESTCASE_NONE)
     {
-        (void) fprintf(
-            stderr,
-            "%s: %s: snprintf() failed - %s.\n",
-	    cmd,
-	    __func__,
-	    strerror(errno)
-            );
-        exit(EXIT_FAILURE);
+        return 0;
     }
 
-    /*
-     * signal failure to client
-     */
-    write_status(status);
-
-    /*
-     * write html file
-     */
-    download_file(
-        "vcs_tcpip_bulletin_board_response.html",
-        html_response,
-        len,
-	0
-        );
-
-    errormsg[0] = 0; /* clear error message */
-
-    if (testcase == TESTCASE_HTML_ONLY_REPLY)
+    for (i = 0; i < count; i++)
     {
-        return;  /* omit image */
+        if (files[i].cacheable && cached != NULL && files[i].buf != NULL)
+        {
+            (void) snprintf(hash, sizeof(hash), "%016llx", hash_file(files[i].buf, files[i].len));
+            if (is_cached(hash))
+            {
+                continue;
+            }
+        }
+
+        cnt = snprintf(entries + pos, sizeof(entries) - pos, fmt_entry, files[i].len, files[i].name);
+        if (cnt < 0 || (size_t) cnt >= sizeof(entries) - pos)
+        {
+            (void) fprintf(
+                stderr,
+                "%s: %s: snprintf() failed - buffer too small.\n",
+	        cmd,
+	        __func__
+                );
+            return -1;
+        }
+        pos += (size_t) cnt;
+    }
+
+    (void) snprintf(s, sizeof(s), fmt_manifest, pos);
+
+    return (write_in_chunks(s, strlen(s)) == -1 || write_in_chunks(entries, pos) == -1) ? -1 : 0;
+}
+
+/**
+ * \brief Write the files of the response
+ *
+ * Write the number of files, their manifest if the client asked for it
+ * and the files using \a download_file().
+ *
+ * \param files the files of the response [IN]
+ * \param count number of files [IN]
+ *
+ * \retval 0 success
+ * \retval -1 failed
+ */
+static int write_files(
+    const file_t *files,
+    size_t count
+    )
+{
+    size_t i;
+
+    if (write_file_count(count) == -1 || write_manifest(files, count) == -1)
+    {
+        return -1;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (download_file(
+            files[i].name,
+            files[i].buf,
+            files[i].len,
+            files[i].blank_chunks,
+            files[i].cacheable,
+            files[i].deflated
+            ) == -1)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Write an error response
+ *
+ * Write an error response as answer to the client's request to
+ * the client using \a write_status() and \a write_files().
+ *
+ * \param status execution status of the business logic [IN]
+ *
+ * \retval 0 success
+ * \retval -1 failed
+ */
+static int error_response(
+    int status
+    )
+{
+    int cnt;
+    const char *format = (const char *) vcs_tcpip_bulletin_board_response_error_thtml;
+    size_t len;
+
+    len = sizeof(vcs_tcpip_bulletin_board_response_error_thtml)
+            + strlen(errormsg);
+
+    char html_response[len];
+
+    /*
+     * encode error message
+     */
+    cnt = snprintf(
+        html_response,
+	len,
+        format,
+        errormsg
+        );
+
+    if (cnt < 0)
+    {
+        (void) fprintf(
+            stderr,
+            "%s: %s: snprintf() failed - %s.\n",
+	    cmd,
+	    __func__,
+	    strerror(errno)
+            );
+        return -1;
     }
 
+    const char * const args[] = { errormsg };
+    const deflated_t deflated = {
+        vcs_tcpip_bulletin_board_response_error_thtml_z,
+        vcs_tcpip_bulletin_board_response_error_thtml_z_parts,
+        sizeof(vcs_tcpip_bulletin_board_response_error_thtml_z_parts)
+            / sizeof(*vcs_tcpip_bulletin_board_response_error_thtml_z_parts),
+        args
+    };
+    file_t files[3];
+    size_t count = 0;
+
+    /*
+     * html file, error.png and in between a really huge file or
+     * nothing after the html file, depending on the testcase
+     */
+    files[count++] = (file_t) {
+        "vcs_tcpip_bulletin_board_response.html",
+        html_response,
+        strlen(html_response),
+        0,
+        0,
+        &deflated
+    };
     if (testcase == TESTCASE_HUGE_FILE)
     {
-	download_file(
-	    "/dev/null",
-	    NULL,
-	    ADDITIONAL_BLANK_CHUNKS * sizeof(chunk_of_blanks),
-	    ADDITIONAL_BLANK_CHUNKS
-	    );
+        files[count++] = (file_t) {
+            "/dev/null",
+            NULL,
+            ADDITIONAL_BLANK_CHUNKS * sizeof(chunk_of_blanks),
+            ADDITIONAL_BLANK_CHUNKS,
+            0,
+            NULL
+        };
+    }
+    if (testcase != TESTCASE_HTML_ONLY_REPLY)
+    {
+        files[count++] = (file_t) { "error.png", error_png, sizeof(error_png), 0, 1, NULL };
     }
 
     /*
-     * write error.png
+     * signal failure to client
      */
-    download_file("error.png", error_png, sizeof(error_png), 0);
+    if (write_status(status) == -1 || write_files(files, count) == -1)
+    {
+        return -1;
+    }
+
+    errormsg[0] = 0; /* clear error message */
+
+    return 0;
 }
 
 /**
  * \brief Write an OK response
  *
  * Write an OK response as answer to the client's request to
- * stdout using \a write_status() and \a download_file().
+ * the client using \a write_status() and \a write_files().
  *
  * \param url zero-terminated string containing the URL to the bulletin board web page [IN]
+ *
+ * \retval 0 success
+ * \retval -1 failed
  */
-static void ok_response(
+static int ok_response(
     const char *url
     )
 {
     int cnt;
+    const char *format = (const char *) vcs_tcpip_bulletin_board_response_ok_thtml;
     size_t len;
 
     /*
@@ -875,7 +1845,7 @@ static void ok_response(
     cnt = snprintf(
             html_response,
 	    len,
-            (const char *) vcs_tcpip_bulletin_board_response_ok_thtml,
+            format,
             url,
 	    url
             );
@@ -889,42 +1859,125 @@ static void ok_response(
 	    __func__,
 	    strerror(errno)
             );
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
-    /*
-     * signal success to client
-     */
-    write_status(SMSL_E_OK);
+    const char * const args[] = { url, url };
+    const deflated_t deflated = {
+        vcs_tcpip_bulletin_board_response_ok_thtml_z,
+        vcs_tcpip_bulletin_board_response_ok_thtml_z_parts,
+        sizeof(vcs_tcpip_bulletin_board_response_ok_thtml_z_parts)
+            / sizeof(*vcs_tcpip_bulletin_board_response_ok_thtml_z_parts),
+        args
+    };
+    file_t files[3];
+    size_t count = 0;
 
     /*
-     * write html file
+     * html file, ok.png and in between a really huge file or nothing
+     * after the html file, depending on the testcase
      */
-    download_file(
+    files[count++] = (file_t) {
         "vcs_tcpip_bulletin_board_response.html",
         html_response,
-	strlen(html_response),
-	0
-        );
-
-    if (testcase == TESTCASE_HTML_ONLY_REPLY)
+        strlen(html_response),
+        0,
+        1,
+        &deflated
+    };
+    if (testcase == TESTCASE_HUGE_FILE)
     {
-        return;  /* omit image */
+        files[count++] = (file_t) {
+            "/dev/null",
+            NULL,
+            ADDITIONAL_BLANK_CHUNKS * sizeof(chunk_of_blanks),
+            ADDITIONAL_BLANK_CHUNKS,
+            0,
+            NULL
+        };
     }
-
-    if (testcase == TESTCASE_HUGE_FILE)
+    if (testcase != TESTCASE_HTML_ONLY_REPLY)
     {
-	download_file(
-	    "/dev/null",
-	    NULL,
-	    ADDITIONAL_BLANK_CHUNKS * sizeof(chunk_of_blanks),
-	    ADDITIONAL_BLANK_CHUNKS
-	    );
+        files[count++] = (file_t) { "ok.png", ok_png, sizeof(ok_png), 0, 1, NULL };
     }
+
     /*
-     * write ok.png
+     * signal success to client
      */
-    download_file("ok.png", ok_png, sizeof(ok_png), 0);
+    return (write_status(SMSL_E_OK) == -1 || write_files(files, count) == -1) ? -1 : 0;
+}
+
+/**
+ * \brief Write a status-only response
+ *
+ * Write the execution status and, in case of failure, the error message
+ * as "error=<length>\n<message>", but no files. Version 2 clients ask for
+ * this with the request field "reply=6\nstatus". The response to a batch
+ * request also carries the status of every record, separated by blanks,
+ * as "results=<length>\n<status> <status> ...".
+ *
+ * \param status execution status of the business logic [IN]
+ * \param records the records of a batch request or NULL [IN]
+ * \param count number of records [IN]
+ *
+ * \retval 0 success
+ * \retval -1 failed
+ */
+static int status_response(
+    int status,
+    const record_t *records,
+    size_t count
+    )
+{
+    static const char * const fmt_error = "error=%zu\n";
+    static const char * const fmt_results = "results=%zu\n";
+    static const char * const no_files = "files=0\n";
+    char s[MAXFILESIZEDIGITS + sizeof(fmt_error)];
+    char result[MAXSTATUSDIGITS + 2];
+    size_t i, len = 0;
+
+    if (write_status(status) == -1)
+    {
+        return -1;
+    }
+
+    if (status != SMSL_E_OK)
+    {
+        (void) snprintf(s, sizeof(s), fmt_error, strlen(errormsg));
+
+        if (write_in_chunks(s, strlen(s)) == -1
+            || write_in_chunks(errormsg, strlen(errormsg)) == -1)
+        {
+            return -1;
+        }
+
+        errormsg[0] = 0; /* clear error message */
+    }
+
+    if (records != NULL)
+    {
+        for (i = 0; i < count; i++)
+        {
+            len += (size_t) snprintf(result, sizeof(result), (i > 0) ? " %d" : "%d", records[i].status);
+        }
+
+        (void) snprintf(s, sizeof(s), fmt_results, len);
+        if (write_in_chunks(s, strlen(s)) == -1)
+        {
+            return -1;
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            (void) snprintf(result, sizeof(result), (i > 0) ? " %d" : "%d", records[i].status);
+            if (write_in_chunks(result, strlen(result)) == -1)
+            {
+                return -1;
+            }
+        }
+    }
+
+    return write_in_chunks(no_files, strlen(no_files));
 }
 
 /**
@@ -1030,7 +2083,12 @@ static int validate_input(
 	    cmd,
 	    __func__
             );
-        exit(EXIT_FAILURE);
+        (void) snprintf(
+            errormsg,
+	    sizeof(errormsg),
+            "Internal server error\n"
+            );
+        return -1;
     }
 
     /*
@@ -1252,169 +2310,134 @@ static int split_input(
 }
 
 /**
- * \brief Write client message into bulletin board content file
- *
- * Write the client message \a msg, sent by \a user together with the
- * URL to the optional image (\a img) into to the bulletin board content file
- * located in the public_html directory in the user's \a homedir.
+ * \brief Build the path of the message store or of a file in it
  *
- * \param homedir zero-terminated string containing the path to the user's home directory [IN]
- * \param user zero-terminated string containing the user name [IN]
- * \param img zero-terminated string containing the URL of the image to be used [IN]
- * \param msg zero-terminated string containing the message to be added [IN]
+ * \param path buffer the path is written to [OUT]
+ * \param size size of \a path [IN]
+ * \param name name of the file, NULL for the store directory [IN]
  *
- * \return Information on whether or not the writing was successful
+ * \return Information on whether or not the path fits
  * \retval 0 success
- * \retval -1 failed
+ * \retval -1 the path is too long
  */
-static int post_message(
-    const char *homedir,
-    const char *user,
-    const char *img,
-    const char *msg
+static int store_path(
+    char *path,
+    size_t size,
+    const char *name
     )
 {
-    char file[MAXPATHLEN];
-    FILE *fp;
     int cnt;
-    char content_entry[sizeof(content_entry_with_img_thtml)
-                        + MAXMESSAGELEN];
-    size_t content_wr_count;
 
-    /*
-     * in the content entry template we have some %s to fill in
-     * user, image and message.
-     */
-    if (img != NULL)
+    if (name != NULL)
     {
         cnt = snprintf(
-	    content_entry,
-	    sizeof(content_entry),
-	    (const char *) content_entry_with_img_thtml,
-	    img,
-	    user,
-	    user,
-	    msg
+            path,
+            size,
+            "%s/public_html/%s/%s",
+            homedir,
+            BULLETIN_BOARD_STORE_DIR,
+            name
             );
     }
     else
     {
         cnt = snprintf(
-	    content_entry,
-	    sizeof(content_entry),
-	    (const char *) content_entry_without_img_thtml,
-	    user,
-	    msg
+            path,
+            size,
+            "%s/public_html/%s",
+            homedir,
+            BULLETIN_BOARD_STORE_DIR
             );
     }
 
-    if (cnt < 0)
-    {
-        (void) snprintf(
-            errormsg,
-	    sizeof(errormsg),
-            "%s: snprintf() failed - <pre>%s</pre>\n",
-	    cmd,
-            strerror(errno)
-            );
-        return -1;
-    }
-    else if ((size_t) cnt >= sizeof(content_entry))
+    if (cnt < 0 || (size_t) cnt >= size)
     {
         (void) snprintf(
             errormsg,
 	    sizeof(errormsg),
-            "Message too long - only a maximum of %d bytes (incl. username) "
-            "are supported\n",
-            MAXMESSAGELEN
+	    "Filename for bulleting board file (incl. path) is too long - "
+	    "only a maximum of %d bytes are supported\n",
+            MAXPATHLEN
             );
         return -1;
     }
 
-    content_wr_count = (size_t) cnt;
+    return 0;
+}
 
-    cnt = snprintf(
-            file,
-	    sizeof(file),
-	    "%s/public_html/%s",
-	    homedir,
-            BULLETIN_BOARD_CONTENT_FILE
-            );
+/**
+ * \brief Open a file of the message store
+ *
+ * \param name name of the file, NULL for a segment [IN]
+ * \param first first record of the segment [IN]
+ * \param suffix SEGMENT_SUFFIX or INDEX_SUFFIX for a segment [IN]
+ * \param flags flags for open() [IN]
+ *
+ * \return the file descriptor
+ * \retval -1 failed, \a errormsg is set
+ */
+static int open_store_file(
+    const char *name,
+    uint64_t first,
+    const char *suffix,
+    int flags
+    )
+{
+    char segment[MAXSEGMENTNAMELEN];
+    char file[MAXPATHLEN];
+    int fd, err;
 
-    if (cnt < 0)
+    if (name == NULL)
     {
-        (void) snprintf(
-            errormsg,
-	    sizeof(errormsg),
-            "%s: snprintf() failed - <pre>%s</pre>\n",
-	    cmd,
-            strerror(errno)
-            );
-        return -1;
+        (void) snprintf(segment, sizeof(segment), "%020" PRIu64 "%s", first, suffix);
+        name = segment;
     }
-    else if ((size_t) cnt >= sizeof(file))
+
+    if (store_path(file, sizeof(file), name) == -1)
     {
-        (void) snprintf(
-            errormsg,
-	    sizeof(errormsg),
-	    "Filename for bulleting board file (incl. path) is too long - "
-	    "only a maximum of %d bytes are supported\n",
-            MAXPATHLEN
-            );
         return -1;
     }
 
-    if ((fp = fopen(file, "a+")) == NULL)
+    if ((fd = open(file, flags | O_CLOEXEC, 0644)) == -1)
     {
+        err = errno;
         (void) snprintf(
             errormsg,
 	    sizeof(errormsg),
             "Unable to open file <code>%s</code> - <pre>%s</pre>\n",
 	    file,
-	    strerror(errno)
+	    strerror(err)
             );
-        return -1;
+        errno = err;  /* for the caller */
     }
 
-    if (flock(fileno(fp), LOCK_EX) == -1)
-    {
-        (void) snprintf(
-            errormsg,
-	    sizeof(errormsg),
-            "Upable to lock file <code>%s</code> - <pre>%s</pre>\n",
-	    file,
-	    strerror(errno)
-            );
-        (void) fclose(fp);
-        return -1;
-    }
+    return fd;
+}
 
-    if (
-	fwrite(
-	    content_entry,
-	    sizeof(char),
-	    content_wr_count,
-	    fp
-	    ) != content_wr_count)
+/**
+ * \brief Create the directory of the message store
+ *
+ * \retval 0 the directory exists
+ * \retval -1 failed, \a errormsg is set
+ */
+static int make_store(
+    void
+    )
+{
+    char dir[MAXPATHLEN];
+
+    if (store_path(dir, sizeof(dir), NULL) == -1)
     {
-        (void) snprintf(
-            errormsg,
-	    sizeof(errormsg),
-            "Unbale to write to file <code>%s</code> - <pre>%s</pre>\n",
-	    file,
-	    strerror(errno)
-            );
-        (void) fclose(fp);
         return -1;
     }
 
-    if (fclose(fp) == EOF)  /* unlock performed automatically with close */
+    if (mkdir(dir, 0755) == -1 && errno != EEXIST)
     {
         (void) snprintf(
             errormsg,
 	    sizeof(errormsg),
-            "Unable to close (flush) file <code>%s</code> - <pre>%s</pre>\n",
-	    file,
+            "Unable to create directory <code>%s</code> - <pre>%s</pre>\n",
+	    dir,
 	    strerror(errno)
             );
         return -1;
@@ -1424,88 +2447,3597 @@ static int post_message(
 }
 
 /**
- * \brief Read, validate and store the client request message.
+ * \brief Open and lock the message store for reading and read its head
  *
- * Read the client's input request from stdin, validate this input by
- * calling \a validate_input() and \a split_input(), and store the
- * client message into bulletin board content file by calling \a
- * post_message().
+ * The head file is locked shared and opened read-only, so reading it
+ * does not look like a post to the board watch. A store which does not
+ * exist yet is read as an empty one.
  *
- * \param homedir zero-terminated string containing the path to the user's
-          home directory [IN]
- * \param mainpagecreated value indicating if main page has been
- *        created successfully (0 in that case; -1 upon failue) [OUT]
+ * \param fd the locked head file, to be closed to unlock it, -1 for an empty store [OUT]
+ * \param head the head of the store [OUT]
  *
- * \return Information on whether or not the processing was successful
- * \retval SMSL_E_OK success
- * \retval SMSL_E_FAILED a general error occured
- * \retval SMSL_E_INVAL input invalid / not accepted
- * \retval SMSL_E_OVERFLOW given input exceeds internal buffer size
+ * \return Information on whether or not the store could be opened
+ * \retval 0 success
+ * \retval -1 failed, \a errormsg is set
  */
-static int process_message(
-    const char *homedir,
-    int mainpagecreated
+static int open_store(
+    int *fd,
+    store_head_t *head
     )
 {
-    char buf[MAXMESSAGELEN];
+    ssize_t cnt;
+
+    *fd = -1;
+    (void) memset(head, 0, sizeof(*head));
+
+    if ((*fd = open_store_file(STORE_HEAD_FILE, 0, NULL, O_RDONLY)) == -1)
+    {
+        return (errno == ENOENT) ? 0 : -1;
+    }
+
+    if (flock(*fd, LOCK_SH) == -1)
+    {
+        (void) snprintf(
+            errormsg,
+	    sizeof(errormsg),
+            "Unable to lock the bulletin board - <pre>%s</pre>\n",
+	    strerror(errno)
+            );
+        (void) close(*fd);
+        *fd = -1;
+        return -1;
+    }
+
+    /*
+     * the head is written last by every post, a file too short to
+     * hold it has never been written completely
+     */
+    if ((cnt = pread(*fd, head, sizeof(*head), 0)) != (ssize_t) sizeof(*head))
+    {
+        (void) memset(head, 0, sizeof(*head));
+        if (cnt == -1)
+        {
+            (void) snprintf(
+                errormsg,
+	        sizeof(errormsg),
+                "Unable to read the bulletin board - <pre>%s</pre>\n",
+	        strerror(errno)
+                );
+            (void) close(*fd);
+            *fd = -1;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Write a buffer completely at an offset
+ *
+ * \param fd the file [IN]
+ * \param buf the data [IN]
+ * \param len length of the data [IN]
+ * \param offset where to write the data [IN]
+ *
+ * \retval 0 success
+ * \retval -1 failed, \a errormsg is set
+ */
+static int write_at(
+    int fd,
+    const void *buf,
+    size_t len,
+    uint64_t offset
+    )
+{
+    ssize_t cnt;
+    size_t pos;
+
+    for (pos = 0; pos < len; pos += (size_t) cnt)
+    {
+        if ((cnt = pwrite(fd, (const char *) buf + pos, len - pos, (off_t) (offset + pos))) == -1)
+        {
+            if (errno == EINTR)
+            {
+                cnt = 0;
+                continue;
+            }
+            (void) snprintf(
+                errormsg,
+	        sizeof(errormsg),
+                "Unable to write to the bulletin board - <pre>%s</pre>\n",
+	        strerror(errno)
+                );
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Read a buffer completely from an offset
+ *
+ * \param fd the file [IN]
+ * \param buf the buffer [OUT]
+ * \param len number of bytes to read [IN]
+ * \param offset where to read from [IN]
+ *
+ * \retval 0 success
+ * \retval -1 failed or the file ends before, \a errormsg is set
+ */
+static int read_at(
+    int fd,
+    void *buf,
+    size_t len,
+    uint64_t offset
+    )
+{
+    ssize_t cnt;
+    size_t pos;
+
+    for (pos = 0; pos < len; pos += (size_t) cnt)
+    {
+        if ((cnt = pread(fd, (char *) buf + pos, len - pos, (off_t) (offset + pos))) <= 0)
+        {
+            if (cnt == -1 && errno == EINTR)
+            {
+                cnt = 0;
+                continue;
+            }
+            (void) snprintf(
+                errormsg,
+	        sizeof(errormsg),
+                "Unable to read the bulletin board - <pre>%s</pre>\n",
+	        (cnt == 0) ? "file truncated" : strerror(errno)
+                );
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Sync a file of the message store if the durability requires it
+ *
+ * \param fd the file [IN]
+ * \param when DURABILITY_SYNC when committing, DURABILITY_PERIODIC when syncing later [IN]
+ *
+ * \retval 0 success or \a durability is not \a when
+ * \retval -1 failed, \a errormsg is set
+ */
+static int sync_store_file(
+    int fd,
+    int when
+    )
+{
+    if (durability == when && fdatasync(fd) == -1)
+    {
+        (void) snprintf(
+            errormsg,
+	    sizeof(errormsg),
+            "Unable to sync the bulletin board - <pre>%s</pre>\n",
+	    strerror(errno)
+            );
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Sync the directory of the message store if the durability requires it
+ *
+ * Files created in the store are found after a crash only then.
+ *
+ * \param when DURABILITY_SYNC when committing, DURABILITY_PERIODIC when syncing later [IN]
+ *
+ * \retval 0 success or \a durability is not \a when
+ * \retval -1 failed, \a errormsg is set
+ */
+static int sync_store_dir(
+    int when
+    )
+{
+    int fd, rc;
+
+    if (durability != when)
+    {
+        return 0;
+    }
+
+    if ((fd = open_store_file(".", 0, NULL, O_RDONLY | O_DIRECTORY)) == -1)
+    {
+        return -1;
+    }
+    rc = sync_store_file(fd, when);
+    (void) close(fd);
+
+    return rc;
+}
+
+/**
+ * \brief Close the files of the message store kept open for appending
+ *
+ * \param all nonzero to close the head and the segment table as well [IN]
+ */
+static void close_appender(
+    int all
+    )
+{
+    if (appender.log_fd != -1)
+    {
+        (void) close(appender.log_fd);
+        (void) close(appender.idx_fd);
+        appender.log_fd = -1;
+        appender.idx_fd = -1;
+    }
+
+    if (all)
+    {
+        if (appender.table_fd != -1)
+        {
+            (void) close(appender.table_fd);
+            appender.table_fd = -1;
+        }
+        if (appender.head_fd != -1)
+        {
+            (void) close(appender.head_fd);
+            appender.head_fd = -1;
+        }
+    }
+}
+
+/**
+ * \brief Lock the message store for appending and read its head
+ *
+ * The head file is opened by the first post of a process and kept open.
+ * Files inherited from a parent process are not used, as they share the
+ * lock with it.
+ *
+ * \param head the head of the store [OUT]
+ *
+ * \retval 0 success
+ * \retval -1 failed, \a errormsg is set
+ */
+static int lock_appender(
+    store_head_t *head
+    )
+{
+    ssize_t cnt;
+
+    if (appender.pid != getpid())
+    {
+        close_appender(1);
+        appender.pid = getpid();
+    }
+
+    if (appender.head_fd == -1
+        && (make_store() == -1
+            || (appender.head_fd = open_store_file(STORE_HEAD_FILE, 0, NULL, O_RDWR | O_CREAT)) == -1))
+    {
+        return -1;
+    }
+
+    if (flock(appender.head_fd, LOCK_EX) == -1)
+    {
+        (void) snprintf(
+            errormsg,
+	    sizeof(errormsg),
+            "Unable to lock the bulletin board - <pre>%s</pre>\n",
+	    strerror(errno)
+            );
+        close_appender(1);
+        return -1;
+    }
+
+    /*
+     * the head is written last by every post, a file too short to
+     * hold it has never been written completely
+     */
+    (void) memset(head, 0, sizeof(*head));
+    if ((cnt = pread(appender.head_fd, head, sizeof(*head), 0)) != (ssize_t) sizeof(*head))
+    {
+        (void) memset(head, 0, sizeof(*head));
+        if (cnt == -1)
+        {
+            (void) snprintf(
+                errormsg,
+	        sizeof(errormsg),
+                "Unable to read the bulletin board - <pre>%s</pre>\n",
+	        strerror(errno)
+                );
+            close_appender(1);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Open the newest segment of the message store for appending
+ *
+ * When rolling, a new segment starting with the next record is
+ * created and added to the segment table. Otherwise the newest segment
+ * is kept open, unless another process has rolled in the meantime.
+ * Whatever a failed post left behind the committed end of the segment
+ * is overwritten by the next records.
+ *
+ * \param head the head of the store, updated when rolling [IN/OUT]
+ * \param roll nonzero to start a new segment [IN]
+ * \param time time of the first record of a new segment [IN]
+ *
+ * \retval 0 success
+ * \retval -1 failed, \a errormsg is set
+ */
+static int open_segment(
+    store_head_t *head,
+    int roll,
+    int64_t time
+    )
+{
+    segment_entry_t entry;
+    int flags = O_WRONLY | O_CREAT | (roll ? O_TRUNC : 0);
+
+    if (roll)
+    {
+        entry.first = head->count;
+        entry.time = time;
+
+        if ((appender.table_fd == -1
+             && (appender.table_fd = open_store_file(STORE_SEGMENTS_FILE, 0, NULL, O_WRONLY | O_CREAT)) == -1)
+            || write_at(appender.table_fd, &entry, sizeof(entry), head->segments * sizeof(entry)) == -1
+            || sync_store_file(appender.table_fd, DURABILITY_SYNC) == -1)
+        {
+            return -1;
+        }
+
+        head->segments++;
+        head->segment = head->count;
+        head->size = 0;
+    }
+    else if (appender.log_fd != -1 && appender.segment == head->segment)
+    {
+        return 0;
+    }
+
+    close_appender(0);
+
+    if ((appender.log_fd = open_store_file(NULL, head->segment, SEGMENT_SUFFIX, flags)) == -1)
+    {
+        return -1;
+    }
+
+    if ((appender.idx_fd = open_store_file(NULL, head->segment, INDEX_SUFFIX, flags)) == -1)
+    {
+        (void) close(appender.log_fd);
+        appender.log_fd = -1;
+        return -1;
+    }
+
+    appender.segment = head->segment;
+
+    return roll ? sync_store_dir(DURABILITY_SYNC) : 0;
+}
+
+/**
+ * \brief Append client messages to the message store
+ *
+ * Append the client messages of the records \a records with the status
+ * SMSL_E_OK, each sent by its user together with the URL to the
+ * optional image, to the message store located in the public_html
+ * directory in the user's home directory.
+ *
+ * The store is a log of binary records (see record_header_t), split
+ * into segments of at most SEGMENT_SIZE bytes named after the
+ * sequence number of their first record. The segment table lists the
+ * first record and its time of every segment, the index of a segment
+ * the time and offset of every SEGMENT_INDEX_INTERVAL-th record. The
+ * head file holds the committed end of the store and serves as its
+ * lock. It is written last, so records of a post which fails halfway
+ * are never seen and are overwritten by the next one. The entries are
+ * rendered from the records when they are read.
+ *
+ * The store is locked once for all records, which are collected in a
+ * buffer and appended with a single write per segment. The files are
+ * kept open for the next post (see \a appender). With DURABILITY_SYNC
+ * the segments, their indexes and the segment table are synced before
+ * the head and the head after it, so a post is durable once it is
+ * committed, with DURABILITY_PERIODIC they are synced by
+ * \a sync_board() later. The status
+ * of records which cannot be written is set to SMSL_E_INVAL.
+ *
+ * \param records the messages to be added [IN/OUT]
+ * \param count number of records [IN]
+ *
+ * \return Information on whether or not the writing was successful
+ * \retval 0 success
+ * \retval -1 failed for at least one record
+ */
+static int append_records(
+    record_t * const *records,
+    size_t count
+    )
+{
+    store_head_t head, next;
+    record_header_t header;
+    index_entry_t entry;
+    char *p;
+    size_t len = 0, need;
+    size_t user_len, img_len, msg_len;
+    int64_t now = (int64_t) time(NULL);
+    int full, rc;
+    size_t i;
+
+    rc = lock_appender(&head);
+    appender.segments = head.segments;
+
+    /*
+     * the times of the records never decrease, even if the clock does,
+     * so they can be searched
+     */
+    next = head;
+    if (now < next.time)
+    {
+        now = next.time;
+    }
+
+    for (i = 0; i < count && rc == 0; i++)
+    {
+        if (records[i]->status != SMSL_E_OK)
+        {
+            continue;  /* rejected already */
+        }
+
+        user_len = strlen(records[i]->user);
+        img_len = (records[i]->img != NULL) ? strlen(records[i]->img) : 0;
+        msg_len = strlen(records[i]->msg);
+        need = sizeof(header) + user_len + img_len + msg_len;
+
+        /*
+         * the pending records are written before the next segment is
+         * started
+         */
+        full = next.segments > 0
+            && next.size + len > 0
+            && next.size + len + need > SEGMENT_SIZE;
+
+        if (full && len > 0
+            && (rc = write_at(appender.log_fd, appender.buf, len, next.size)) == 0
+            && (rc = sync_store_file(appender.log_fd, DURABILITY_SYNC)) == 0
+            && (rc = sync_store_file(appender.idx_fd, DURABILITY_SYNC)) == 0)
+        {
+            next.size += len;
+            len = 0;
+        }
+
+        if (rc == 0)
+        {
+            rc = open_segment(&next, next.segments == 0 || full, now);
+        }
+
+        if (rc == 0 && (next.count - next.segment) % SEGMENT_INDEX_INTERVAL == 0)
+        {
+            entry.time = now;
+            entry.offset = next.size + len;
+            rc = write_at(
+                appender.idx_fd,
+                &entry,
+                sizeof(entry),
+                (next.count - next.segment) / SEGMENT_INDEX_INTERVAL * sizeof(entry)
+                );
+        }
+
+        /*
+         * the buffer is kept for the next posts
+         */
+        if (rc == 0 && len + need > appender.size)
+        {
+            if ((p = realloc(appender.buf, 2 * (len + need))) == NULL)
+            {
+                (void) snprintf(errormsg, sizeof(errormsg), "Server out of memory\n");
+                rc = -1;
+            }
+            else
+            {
+                appender.buf = p;
+                appender.size = 2 * (len + need);
+            }
+        }
+
+        if (rc == 0)
+        {
+            header.len = (uint32_t) need;
+            header.user_len = (uint32_t) user_len;
+            header.img_len = (uint32_t) img_len;
+            header.msg_len = (uint32_t) msg_len;
+            header.time = now;
+
+            p = appender.buf + len;
+            (void) memcpy(p, &header, sizeof(header));
+            p += sizeof(header);
+            (void) memcpy(p, records[i]->user, user_len);
+            p += user_len;
+            if (img_len > 0)
+            {
+                (void) memcpy(p, records[i]->img, img_len);
+                p += img_len;
+            }
+            (void) memcpy(p, records[i]->msg, msg_len);
+
+            len += need;
+            next.count++;
+            next.time = now;
+        }
+    }
+
+    /*
+     * committing the new head makes the records visible
+     */
+    if (rc == 0 && len > 0
+        && (rc = write_at(appender.log_fd, appender.buf, len, next.size)) == 0)
+    {
+        next.size += len;
+    }
+
+    if (rc == 0 && next.count != head.count)
+    {
+        rc = (sync_store_file(appender.log_fd, DURABILITY_SYNC) == -1
+              || sync_store_file(appender.idx_fd, DURABILITY_SYNC) == -1
+              || write_at(appender.head_fd, &next, sizeof(next), 0) == -1
+              || sync_store_file(appender.head_fd, DURABILITY_SYNC) == -1) ? -1 : 0;
+    }
+
+    if (rc == 0)
+    {
+        (void) flock(appender.head_fd, LOCK_UN);
+    }
+    else
+    {
+        close_appender(1);  /* unlock performed automatically with close */
+
+        for (i = 0; i < count; i++)
+        {
+            if (records[i]->status == SMSL_E_OK)
+            {
+                records[i]->status = SMSL_E_INVAL;
+            }
+        }
+    }
+
+    return rc;
+}
+
+/**
+ * \brief Split an entry of the board of earlier versions into its fields
+ *
+ * The entry is matched against the content entry template \a template:
+ * its text between the %s must match, and each field ends where the
+ * text following it is found first, the last field where the entry
+ * ends with the rest of the template.
+ *
+ * \param template content entry template [IN]
+ * \param entry the entry [IN]
+ * \param len length of \a entry [IN]
+ * \param fields the fields in the order of the template [OUT]
+ * \param lens the lengths of the fields [OUT]
+ * \param count number of %s in \a template [IN]
+ *
+ * \retval 0 success
+ * \retval -1 the entry does not match the template
+ */
+static int parse_entry(
+    const char *template,
+    char *entry,
+    size_t len,
+    char **fields,
+    size_t *lens,
+    size_t count
+    )
+{
+    const char *lit = template, *next;
+    char *p = entry, *end = entry + len, *q;
+    size_t lit_len, i;
+
+    for (i = 0; i <= count; i++)
+    {
+        next = (i < count) ? strstr(lit, "%s") : lit + strlen(lit);
+        lit_len = (size_t) (next - lit);
+
+        if (i > 0)
+        {
+            /*
+             * the previous field ends before this text
+             */
+            if (i == count)
+            {
+                q = (lit_len <= (size_t) (end - p)) ? end - lit_len : NULL;
+            }
+            else
+            {
+                for (q = p; q + lit_len <= end && memcmp(q, lit, lit_len) != 0; q++)
+                {
+                    ;
+                }
+                if (q + lit_len > end)
+                {
+                    q = NULL;
+                }
+            }
+            if (q == NULL)
+            {
+                return -1;
+            }
+            fields[i - 1] = p;
+            lens[i - 1] = (size_t) (q - p);
+            p = q;
+        }
+
+        if ((size_t) (end - p) < lit_len || memcmp(p, lit, lit_len) != 0)
+        {
+            return -1;
+        }
+        p += lit_len;
+        lit = next + 2;
+    }
+
+    return (p == end) ? 0 : -1;
+}
+
+/**
+ * \brief Import the bulletin board of earlier versions
+ *
+ * Earlier versions appended the rendered entries to
+ * BULLETIN_BOARD_CONTENT_FILE in the public_html directory, which the
+ * PHP main page included. While the message store is empty, these
+ * entries are parsed back into user, image URL and message and
+ * appended as records, timed at the import, as the file holds no
+ * times. Entries which match neither content entry template are
+ * skipped. The file is locked exclusively meanwhile, as earlier
+ * versions did for posting, so concurrent processes import it once.
+ * It is left in place for the PHP page.
+ *
+ * \retval 0 success or nothing to import
+ * \retval -1 failed, \a errormsg is set
+ */
+static int import_board(
+    void
+    )
+{
+    const char *with_img = (const char *) content_entry_with_img_thtml;
+    const char *without_img = (const char *) content_entry_without_img_thtml;
+    char file[MAXPATHLEN];
+    char *fields[4];
+    size_t lens[4];
+    store_head_t head;
+    struct stat st;
+    record_t *records = NULL;
+    record_t **pointers = NULL;
+    char *content = NULL, *entry, *next, *end;
+    size_t len, count = 0, skipped = 0, max;
+    int fd, head_fd, cnt, rc = 0;
+
+    cnt = snprintf(
+        file,
+        sizeof(file),
+        "%s/public_html/%s",
+        homedir,
+        BULLETIN_BOARD_CONTENT_FILE
+        );
+    if (cnt < 0 || (size_t) cnt >= sizeof(file))
+    {
+        (void) snprintf(errormsg, sizeof(errormsg), "Path of the old bulletin board too long\n");
+        return -1;
+    }
+
+    if ((fd = open(file, O_RDONLY | O_CLOEXEC)) == -1)
+    {
+        return 0;  /* nothing to import */
+    }
+
+    if (flock(fd, LOCK_EX) == -1
+        || fstat(fd, &st) == -1)
+    {
+        (void) snprintf(
+            errormsg,
+	    sizeof(errormsg),
+            "Unable to lock file <code>%s</code> - <pre>%s</pre>\n",
+	    file,
+	    strerror(errno)
+            );
+        (void) close(fd);
+        return -1;
+    }
+
+    if ((rc = open_store(&head_fd, &head)) == -1)
+    {
+        (void) close(fd);
+        return -1;
+    }
+    if (head_fd != -1)
+    {
+        (void) close(head_fd);
+    }
+
+    if (head.count > 0 || st.st_size == 0)
+    {
+        (void) close(fd);
+        return 0;  /* imported already */
+    }
+
+    /*
+     * every entry starts with a line "<dt>", which the allowed tags of
+     * a message cannot form
+     */
+    len = (size_t) st.st_size;
+    max = len / MINENTRYLEN + 1;
+    if ((content = malloc(len + 1)) == NULL
+        || (records = malloc(max * sizeof(*records))) == NULL
+        || (pointers = malloc(max * sizeof(*pointers))) == NULL)
+    {
+        (void) snprintf(errormsg, sizeof(errormsg), "Server out of memory\n");
+        rc = -1;
+    }
+    else if ((rc = read_at(fd, content, len, 0)) == 0)
+    {
+        content[len] = '\0';
+
+        for (entry = content; entry != NULL && *entry != '\0' && count < max; entry = next)
+        {
+            if ((next = strstr(entry + 1, "\n<dt>\n")) != NULL)
+            {
+                next++;
+            }
+            end = (next != NULL) ? next : content + len;
+
+            /*
+             * the fields are terminated once the entry has matched, in
+             * front of the text following them
+             */
+            if (parse_entry(with_img, entry, (size_t) (end - entry), fields, lens, 4) == 0)
+            {
+                fields[0][lens[0]] = '\0';
+                fields[1][lens[1]] = '\0';
+                fields[3][lens[3]] = '\0';
+                records[count].img = fields[0];
+                records[count].user = fields[1];
+                records[count].msg = fields[3];
+            }
+            else if (parse_entry(without_img, entry, (size_t) (end - entry), fields, lens, 2) == 0)
+            {
+                fields[0][lens[0]] = '\0';
+                fields[1][lens[1]] = '\0';
+                records[count].img = NULL;
+                records[count].user = fields[0];
+                records[count].msg = fields[1];
+            }
+            else
+            {
+                skipped++;
+                continue;
+            }
+            records[count].status = SMSL_E_OK;
+            pointers[count] = &records[count];
+            count++;
+        }
+
+        if (count > 0)
+        {
+            rc = append_records(pointers, count);
+        }
+    }
+
+    if (rc == 0 && skipped > 0)
+    {
+        (void) fprintf(
+            stderr,
+            "%s: %s: %zu entries of %s do not match the templates and were not imported.\n",
+	    cmd,
+	    __func__,
+	    skipped,
+	    file
+            );
+    }
+
+    free(pointers);
+    free(records);
+    free(content);
+    (void) close(fd);  /* unlock performed automatically with close */
+
+    return rc;
+}
+
+/**
+ * \brief Sync the message store up to its committed end
+ *
+ * Used with DURABILITY_PERIODIC. The store is locked shared, so no post
+ * is committed meanwhile: starting with the newest segment when this
+ * process committed its first post since the last sync, the segments
+ * are synced with their indexes, the segment table and the directory
+ * if segments were added since, then the head. Older segments were
+ * synced before or were written by other processes only, which sync
+ * them themselves.
+ *
+ * \param segments the segments of the store before that post [IN]
+ *
+ * \retval 0 success
+ * \retval -1 failed, \a errormsg is set
+ */
+static int sync_store(
+    uint64_t segments
+    )
+{
+    static const char * const suffixes[] = { SEGMENT_SUFFIX, INDEX_SUFFIX };
+    store_head_t head;
+    segment_entry_t entry;
+    int head_fd, table_fd = -1, fd, rc;
+    uint64_t i;
+    size_t j;
+
+    if ((rc = open_store(&head_fd, &head)) == -1 || head_fd == -1)
+    {
+        return rc;
+    }
+
+    if (head.segments > 0
+        && (table_fd = open_store_file(STORE_SEGMENTS_FILE, 0, NULL, O_RDONLY)) == -1)
+    {
+        rc = -1;
+    }
+
+    for (i = (segments > 0) ? segments - 1 : 0; i < head.segments && rc == 0; i++)
+    {
+        rc = read_at(table_fd, &entry, sizeof(entry), i * sizeof(entry));
+
+        for (j = 0; j < sizeof(suffixes) / sizeof(*suffixes) && rc == 0; j++)
+        {
+            if ((fd = open_store_file(NULL, entry.first, suffixes[j], O_RDONLY)) == -1)
+            {
+                rc = -1;
+            }
+            else
+            {
+                rc = sync_store_file(fd, DURABILITY_PERIODIC);
+                (void) close(fd);
+            }
+        }
+    }
+
+    if (rc == 0 && head.segments != segments)
+    {
+        rc = (sync_store_file(table_fd, DURABILITY_PERIODIC) == -1
+              || sync_store_dir(DURABILITY_PERIODIC) == -1) ? -1 : 0;
+    }
+
+    if (rc == 0)
+    {
+        rc = sync_store_file(head_fd, DURABILITY_PERIODIC);
+    }
+
+    if (table_fd != -1)
+    {
+        (void) close(table_fd);
+    }
+    (void) close(head_fd);  /* unlock performed automatically with close */
+
+    return rc;
+}
+
+/**
+ * \brief Sync the posts of this process committed since the last sync
+ *
+ * Does nothing unless a commit has marked the store dirty. If the sync
+ * fails, the store stays dirty and the error is printed.
+ *
+ * \retval 0 success or nothing to sync
+ * \retval -1 failed
+ */
+static int sync_board(
+    void
+    )
+{
+    uint64_t segments;
+    int dirty, rc = 0;
+
+    (void) pthread_mutex_lock(&sync_mutex);
+
+    (void) pthread_mutex_lock(&commit_mutex);
+    dirty = store_dirty;
+    segments = dirty_segments;
+    store_dirty = 0;
+    (void) pthread_mutex_unlock(&commit_mutex);
+
+    if (dirty && (rc = sync_store(segments)) == -1)
+    {
+        (void) fprintf(
+            stderr,
+            "%s: %s: %s",
+	    cmd,
+	    __func__,
+	    errormsg
+            );
+
+        (void) pthread_mutex_lock(&commit_mutex);
+        if (!store_dirty || segments < dirty_segments)
+        {
+            dirty_segments = segments;
+        }
+        store_dirty = 1;
+        (void) pthread_mutex_unlock(&commit_mutex);
+    }
+
+    (void) pthread_mutex_unlock(&sync_mutex);
+
+    return rc;
+}
+
+/**
+ * \brief Sync the message store in the background
+ *
+ * Thread function of the syncer: waits until a commit marks the store
+ * dirty, then \a sync_interval milliseconds for more commits and syncs
+ * them all at once. So no post stays unsynced for longer than that.
+ *
+ * \param arg unused [IN]
+ *
+ * \return never
+ */
+static void *run_syncer(
+    void *arg
+    )
+{
+    struct timespec interval;
+
+    (void) arg;
+
+    interval.tv_sec = sync_interval / 1000;
+    interval.tv_nsec = sync_interval % 1000 * 1000000;
+
+    for (;;)
+    {
+        (void) pthread_mutex_lock(&commit_mutex);
+        while (!store_dirty)
+        {
+            (void) pthread_cond_wait(&sync_cond, &commit_mutex);
+        }
+        (void) pthread_mutex_unlock(&commit_mutex);
+
+        while (nanosleep(&interval, &interval) == -1 && errno == EINTR)
+        {
+            ;
+        }
+        interval.tv_sec = sync_interval / 1000;
+        interval.tv_nsec = sync_interval % 1000 * 1000000;
+
+        (void) sync_board();
+    }
+
+    return NULL;
+}
+
+/**
+ * \brief Start a background thread once per process
+ *
+ * Called with \a commit_mutex locked by the first commit of a process.
+ * The thread blocks all signals, which are left to the threads of the
+ * server.
+ *
+ * \param run the thread function [IN]
+ * \param pid the process the thread runs in [IN/OUT]
+ *
+ * \retval 0 the thread runs
+ * \retval -1 it cannot be started, the error is printed
+ */
+static int start_background(
+    void *(*run)(void *),
+    pid_t *pid
+    )
+{
+    pthread_t thread;
+    sigset_t all, old;
+    int rc;
+
+    if (*pid == getpid())
+    {
+        return 0;
+    }
+
+    (void) sigfillset(&all);
+    (void) pthread_sigmask(SIG_SETMASK, &all, &old);
+    rc = pthread_create(&thread, NULL, run, NULL);
+    (void) pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (rc != 0)
+    {
+        (void) fprintf(
+            stderr,
+            "%s: %s: pthread_create() failed - %s.\n",
+	    cmd,
+	    __func__,
+	    strerror(rc)
+            );
+        return -1;
+    }
+
+    (void) pthread_detach(thread);
+    *pid = getpid();
+
+    return 0;
+}
+
+/**
+ * \brief Mark the message store dirty after a commit
+ *
+ * Called with \a commit_mutex locked, with DURABILITY_PERIODIC only.
+ * The syncer thread is started by the first commit of a process. If it
+ * cannot be started, the store is synced right away.
+ *
+ * \param segments the segments of the store before the commit [IN]
+ */
+static void mark_store_dirty(
+    uint64_t segments
+    )
+{
+    if (!store_dirty || segments < dirty_segments)
+    {
+        dirty_segments = segments;
+    }
+    store_dirty = 1;
+
+    if (start_background(run_syncer, &syncer_pid) == -1)
+    {
+        (void) pthread_mutex_unlock(&commit_mutex);
+        (void) sync_board();
+        (void) pthread_mutex_lock(&commit_mutex);
+        return;
+    }
+
+    (void) pthread_cond_signal(&sync_cond);
+}
+
+/**
+ * \brief Publish the main page if posts were committed since
+ *
+ * Does nothing unless a commit has marked the page stale. If
+ * publishing fails, the page stays stale and the error is printed.
+ *
+ * \retval 0 success or nothing to publish
+ * \retval -1 failed
+ */
+static int publish_board(
+    void
+    )
+{
+    int stale, rc = 0;
+
+    (void) pthread_mutex_lock(&commit_mutex);
+    stale = page_stale;
+    page_stale = 0;
+    (void) pthread_mutex_unlock(&commit_mutex);
+
+    if (stale && (rc = publish_page()) == -1)
+    {
+        (void) fprintf(
+            stderr,
+            "%s: %s: %s",
+	    cmd,
+	    __func__,
+	    errormsg
+            );
+
+        (void) pthread_mutex_lock(&commit_mutex);
+        page_stale = 1;
+        (void) pthread_mutex_unlock(&commit_mutex);
+    }
+
+    return rc;
+}
+
+/**
+ * \brief Publish the main page in the background
+ *
+ * Thread function of the publisher: waits until a commit marks the
+ * page stale, then \a publish_interval milliseconds for more commits
+ * and publishes them all at once, so the posts are acknowledged
+ * without waiting for the page.
+ *
+ * \param arg unused [IN]
+ *
+ * \return never
+ */
+static void *run_publisher(
+    void *arg
+    )
+{
+    struct timespec interval;
+
+    (void) arg;
+
+    for (;;)
+    {
+        (void) pthread_mutex_lock(&commit_mutex);
+        while (!page_stale)
+        {
+            (void) pthread_cond_wait(&publish_cond, &commit_mutex);
+        }
+        (void) pthread_mutex_unlock(&commit_mutex);
+
+        interval.tv_sec = publish_interval / 1000;
+        interval.tv_nsec = publish_interval % 1000 * 1000000;
+        while (nanosleep(&interval, &interval) == -1 && errno == EINTR)
+        {
+            ;
+        }
+
+        (void) publish_board();
+    }
+
+    return NULL;
+}
+
+/**
+ * \brief Mark the main page stale after a commit
+ *
+ * Called with \a commit_mutex locked. The publisher thread is started
+ * by the first commit of a process. If it cannot be started, the page
+ * is published right away.
+ */
+static void mark_page_stale(
+    void
+    )
+{
+    page_stale = 1;
+
+    if (start_background(run_publisher, &publisher_pid) == -1)
+    {
+        (void) pthread_mutex_unlock(&commit_mutex);
+        (void) publish_board();
+        (void) pthread_mutex_lock(&commit_mutex);
+        return;
+    }
+
+    (void) pthread_cond_signal(&publish_cond);
+}
+
+/**
+ * \brief Commit a group of queued posts as leader
+ *
+ * Called with \a commit_mutex locked, which is unlocked while the group
+ * is written. The leader waits up to \a commit_window microseconds for
+ * \a commit_batch records to be queued, then takes the posts from the
+ * head of the queue up to that many records (at least one post) and
+ * appends them with a single call of \a append_records().
+ */
+static void lead_commit(
+    void
+    )
+{
+    struct timespec until;
+    record_t **records;
+    commit_t *group, *last, *c;
+    size_t n, i, j;
+    int rc;
+
+    commit_leading = 1;
+
+    if (commit_window > 0 && commit_queued < commit_batch)
+    {
+        (void) clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += commit_window / 1000000;
+        until.tv_nsec += commit_window % 1000000 * 1000;
+        if (until.tv_nsec >= 1000000000)
+        {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000;
+        }
+        while (commit_queued < commit_batch
+               && pthread_cond_timedwait(&commit_cond, &commit_mutex, &until) != ETIMEDOUT)
+        {
+            ;
+        }
+    }
+
+    group = commit_queue;
+    n = group->count;
+    for (last = group; last->next != NULL && n + last->next->count <= commit_batch; last = last->next)
+    {
+        n += last->next->count;
+    }
+    commit_queue = last->next;
+    if (commit_queue == NULL)
+    {
+        commit_tail = &commit_queue;
+    }
+    last->next = NULL;
+    commit_queued -= n;
+
+    (void) pthread_mutex_unlock(&commit_mutex);
+
+    if ((records = malloc(n * sizeof(*records))) == NULL)
+    {
+        (void) snprintf(errormsg, sizeof(errormsg), "Server out of memory\n");
+        rc = -1;
+    }
+    else
+    {
+        for (c = group, i = 0; c != NULL; c = c->next)
+        {
+            for (j = 0; j < c->count; j++)
+            {
+                records[i++] = &c->records[j];
+            }
+        }
+        rc = append_records(records, n);
+        free(records);
+    }
+
+    (void) pthread_mutex_lock(&commit_mutex);
+
+    if (rc == 0)
+    {
+        mark_page_stale();
+    }
+
+    if (rc == 0 && durability == DURABILITY_PERIODIC)
+    {
+        mark_store_dirty(appender.segments);
+    }
+
+    for (c = group; c != NULL; c = c->next)
+    {
+        c->rc = rc;
+        if (rc == -1)
+        {
+            (void) memcpy(c->errormsg, errormsg, sizeof(c->errormsg));
+        }
+        c->done = 1;
+    }
+
+    commit_leading = 0;
+    (void) pthread_cond_broadcast(&commit_cond);
+}
+
+/**
+ * \brief Write client messages into the message store
+ *
+ * Post the client messages of the records \a records with the status
+ * SMSL_E_OK by group commit: the post is queued together with the
+ * posts of the other threads. If no thread is committing, this one
+ * becomes the leader and commits the queued posts (see
+ * \a lead_commit()), otherwise it waits for the leader and takes over
+ * if its post was left in the queue. So the store is locked once for
+ * all posts arriving while a group is written. The status of records
+ * which cannot be written is set to SMSL_E_INVAL. Once records are
+ * committed, \a durability_level is set to the name of \a durability.
+ *
+ * \param homedir zero-terminated string containing the path to the user's home directory [IN]
+ * \param records the messages to be added [IN/OUT]
+ * \param count number of records [IN]
+ *
+ * \return Information on whether or not the writing was successful
+ * \retval 0 success
+ * \retval -1 failed for at least one record
+ */
+static int post_message(
+    const char *homedir,
+    record_t *records,
+    size_t count
+    )
+{
+    commit_t post;
+    size_t i;
+
+    (void) homedir;  /* the store is located by store_path() */
+
+    post.records = records;
+    post.count = count;
+    post.done = 0;
+    post.rc = 0;
+    post.next = NULL;
+
+    (void) pthread_mutex_lock(&commit_mutex);
+
+    *commit_tail = &post;
+    commit_tail = &post.next;
+    commit_queued += count;
+    if (commit_leading && commit_queued >= commit_batch)
+    {
+        (void) pthread_cond_broadcast(&commit_cond);  /* the group is full */
+    }
+
+    while (!post.done)
+    {
+        if (!commit_leading)
+        {
+            lead_commit();
+        }
+        else
+        {
+            (void) pthread_cond_wait(&commit_cond, &commit_mutex);
+        }
+    }
+
+    (void) pthread_mutex_unlock(&commit_mutex);
+
+    if (post.rc == -1)
+    {
+        (void) memcpy(errormsg, post.errormsg, sizeof(errormsg));
+    }
+    else
+    {
+        for (i = 0; i < count && durability_level == NULL; i++)
+        {
+            if (records[i].status == SMSL_E_OK)
+            {
+                durability_level = durability_names[durability];
+            }
+        }
+    }
+
+    return post.rc;
+}
+
+/**
+ * \brief Make sure the main page exists
+ *
+ * \retval 0 the main page exists
+ * \retval -1 the main page could not be created
+ */
+static int check_main_page(void)
+{
+    /*
+     * retry in case the main page could not be created earlier
+     */
+    if (mainpagecreated != 0)
+    {
+        mainpagecreated = create_main_page(homedir);
+    }
+
+    /*
+     * if we could not create the main page, we simply discard all the
+     * input from the client and report the error to the client
+     */
+    if (mainpagecreated != 0)
+    {
+        (void) snprintf(
+            errormsg,
+	    sizeof(errormsg),
+            "Server could not create main HTML page\n"
+            );
+	return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Validate a client request message
+ *
+ * Validate the client's input request \a buf by calling \a
+ * validate_input() and split it into a record by calling \a
+ * split_input().
+ *
+ * \param buf zero-terminated request, modified by \a split_input() [IN]
+ * \param len length of the request [IN]
+ * \param record set to the parts of the request [OUT]
+ *
+ * \return Information on whether or not the request is accepted
+ * \retval SMSL_E_OK success
+ * \retval SMSL_E_INVAL input invalid / not accepted
+ */
+static int prepare_record(
+    char *buf,
+    size_t len,
+    record_t *record
+    )
+{
+    if (validate_input(buf, len) == -1)
+    {
+        return SMSL_E_INVAL;    /* input malformed */
+    }
+
+    if (split_input(buf, &record->user, &record->img, &record->msg) == -1)
+    {
+        return SMSL_E_INVAL;    /* input malformed */
+    }
+
+    return SMSL_E_OK;
+}
+
+/**
+ * \brief Validate and store the client request message.
+ *
+ * Validate the client's input request \a buf by calling \a
+ * prepare_record(), and store the client message into the message
+ * store by calling \a post_message().
+ *
+ * \param buf zero-terminated request, modified by \a split_input() [IN]
+ * \param len length of the request [IN]
+ *
+ * \return Information on whether or not the processing was successful
+ * \retval SMSL_E_OK success
+ * \retval SMSL_E_FAILED a general error occured
+ * \retval SMSL_E_INVAL input invalid / not accepted
+ */
+static int process_request(
+    char *buf,
+    size_t len
+    )
+{
+    record_t record;
+
+    if (check_main_page() == -1)
+    {
+	return SMSL_E_FAILED;
+    }
+
+    if ((record.status = prepare_record(buf, len, &record)) != SMSL_E_OK)
+    {
+        return record.status;
+    }
+
+    (void) post_message(homedir, &record, 1);
+
+    return record.status;  /* SMSL_E_INVAL if the write failed */
+}
+
+/**
+ * \brief Process a version 1 request
+ *
+ * Copy the request \a req, i.e. everything the client sent before
+ * closing its sending direction, into a zero-terminated buffer and
+ * process it by calling \a process_request().
+ *
+ * \param req the request as received from the client [IN]
+ * \param len length of the request [IN]
+ *
+ * \return Information on whether or not the processing was successful
+ * \retval SMSL_E_OK success
+ * \retval SMSL_E_FAILED a general error occured
+ * \retval SMSL_E_INVAL input invalid / not accepted
+ * \retval SMSL_E_OVERFLOW given input exceeds internal buffer size
+ */
+static int process_plain_request(
+    const char *req,
+    size_t len
+    )
+{
+    char buf[MAXMESSAGELEN];
+
+    if (len == 0)
+    {
+        return SMSL_E_INVAL;  /* nothing read at all */
+    }
+
+    if (len >= sizeof(buf))
+    {
+        (void) snprintf(
+            errormsg,
+	    sizeof(errormsg),
+	    "Server input buffer overflow - "
+	    "processing of input messages is limited to %u bytes\n",
+	    MAXMESSAGELEN
+            );
+        return SMSL_E_OVERLOW;
+    }
+
+    memcpy(buf, req, len);
+    buf[len] = 0;
+
+    return process_request(buf, len);
+}
+
+/**
+ * \brief Parse a header line of the framed protocol
+ *
+ * Parse the line "<keyword>=<decimal number>\n" at the begin of \a buf.
+ *
+ * \param buf the input [IN]
+ * \param len number of bytes in \a buf [IN]
+ * \param key buffer of MAXKEYLEN bytes set to the keyword [OUT]
+ * \param value set to the number [OUT]
+ *
+ * \return the length of the line
+ * \retval 0 the line is not complete yet
+ * \retval -1 the line is malformed
+ */
+static ssize_t parse_header(
+    const char *buf,
+    size_t len,
+    char *key,
+    size_t *value
+    )
+{
+    const char *nl, *eq;
+    char digits[MAXFILESIZEDIGITS + 1];
+    char *end;
+    unsigned long long v;
+
+    if ((nl = memchr(buf, '\n', (len < MAXHEADERLEN) ? len : MAXHEADERLEN)) == NULL)
+    {
+        return (len < MAXHEADERLEN) ? 0 : -1;
+    }
+
+    if ((eq = memchr(buf, '=', nl - buf)) == NULL
+        || eq == buf
+        || (size_t) (eq - buf) >= MAXKEYLEN
+        || (size_t) (nl - eq - 1) > MAXFILESIZEDIGITS
+        || !isdigit((unsigned char) eq[1]))
+    {
+        return -1;
+    }
+
+    memcpy(key, buf, eq - buf);
+    key[eq - buf] = 0;
+    memcpy(digits, eq + 1, nl - eq - 1);
+    digits[nl - eq - 1] = 0;
+
+    errno = 0;
+    v = strtoull(digits, &end, 10);
+    if (*end != 0 || errno != 0 || v > SIZE_MAX)
+    {
+        return -1;
+    }
+
+    *value = (size_t) v;
+
+    return nl - buf + 1;
+}
+
+/**
+ * \brief Parse the fields of a version 2 request
+ *
+ * The fields are given as "<keyword>=<length>\n" followed by that many
+ * bytes. Fields not in \a keywords are skipped, so later versions may
+ * add fields.
+ *
+ * \param buf the fields [IN]
+ * \param len length of the fields [IN]
+ * \param keywords the known keywords [IN]
+ * \param count number of keywords [IN]
+ * \param field set to the value of each known field, NULL if missing [OUT]
+ * \param field_len set to the length of each known field [OUT]
+ *
+ * \retval SMSL_E_OK success
+ * \retval SMSL_E_INVAL the fields are malformed
+ */
+static int parse_fields(
+    const char *buf,
+    size_t len,
+    const char * const *keywords,
+    size_t count,
+    const char **field,
+    size_t *field_len
+    )
+{
+    char key[MAXKEYLEN];
+    size_t pos, value, i;
+    ssize_t hl;
+
+    for (i = 0; i < count; i++)
+    {
+        field[i] = NULL;
+        field_len[i] = 0;
+    }
+
+    for (pos = 0; pos < len; pos += hl + value)
+    {
+        if ((hl = parse_header(buf + pos, len - pos, key, &value)) <= 0
+            || value > len - pos - hl)
+        {
+            (void) snprintf(
+                errormsg,
+	        sizeof(errormsg),
+                "Malformed request field at position %zu\n",
+                pos
+                );
+            return SMSL_E_INVAL;
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            if (strcmp(key, keywords[i]) == 0)
+            {
+                field[i] = buf + pos + hl;
+                field_len[i] = value;
+            }
+        }
+    }
+
+    return SMSL_E_OK;
+}
+
+/**
+ * \brief Reassemble a version 1 request from version 2 fields
+ *
+ * \param field the fields "user", "img" and "message", "img" may be NULL [IN]
+ * \param field_len the lengths of the fields [IN]
+ * \param request buffer of at least the length of the fields plus
+ * RECORDOVERHEAD bytes, set to the zero-terminated request [OUT]
+ * \param len set to the length of the request [OUT]
+ *
+ * \retval SMSL_E_OK success
+ * \retval SMSL_E_INVAL input invalid / not accepted
+ * \retval SMSL_E_OVERFLOW given input exceeds internal buffer size
+ */
+static int assemble_request(
+    const char * const *field,
+    const size_t *field_len,
+    char *request,
+    size_t *len
+    )
+{
+    static const char * const keywords[] = { "user", "img", "message" };
+    size_t pos, total;
+    unsigned i;
+
+    if (field[0] == NULL || field[2] == NULL)
+    {
+        (void) snprintf(
+            errormsg,
+	    sizeof(errormsg),
+            "Field <code>%s</code> is missing in request\n",
+            (field[0] == NULL) ? keywords[0] : keywords[2]
+            );
+        return SMSL_E_INVAL;
+    }
+
+    for (i = 0; i < 2; i++)
+    {
+        if (field[i] != NULL && memchr(field[i], '\n', field_len[i]) != NULL)
+        {
+            (void) snprintf(
+                errormsg,
+	        sizeof(errormsg),
+                "Field <code>%s</code> contains a newline\n",
+                keywords[i]
+                );
+            return SMSL_E_INVAL;
+        }
+    }
+
+    /*
+     * user=<username>\n[img=<URL>\n]<message>
+     */
+    total = strlen("user=") + field_len[0] + 1 + field_len[2];
+    if (field[1] != NULL)
+    {
+        total += strlen("img=") + field_len[1] + 1;
+    }
+
+    if (total >= MAXMESSAGELEN)
+    {
+        (void) snprintf(
+            errormsg,
+	    sizeof(errormsg),
+	    "Server input buffer overflow - "
+	    "processing of input messages is limited to %u bytes\n",
+	    MAXMESSAGELEN
+            );
+        return SMSL_E_OVERLOW;
+    }
+
+    pos = 0;
+    memcpy(request + pos, "user=", strlen("user="));
+    pos += strlen("user=");
+    memcpy(request + pos, field[0], field_len[0]);
+    pos += field_len[0];
+    request[pos++] = '\n';
+    if (field[1] != NULL)
+    {
+        memcpy(request + pos, "img=", strlen("img="));
+        pos += strlen("img=");
+        memcpy(request + pos, field[1], field_len[1]);
+        pos += field_len[1];
+        request[pos++] = '\n';
+    }
+    memcpy(request + pos, field[2], field_len[2]);
+    request[total] = 0;
+    *len = total;
+
+    return SMSL_E_OK;
+}
+
+/**
+ * \brief Process a version 2 request
+ *
+ * A version 2 request consists of the fields "user", the optional
+ * "img" and "message" (see \a parse_fields()). The fields are
+ * reassembled into a version 1 request which is processed by calling
+ * \a process_request(), so both versions are validated the same way.
+ * The optional field "reply" with the value "status" asks for a
+ * response without files. The optional field "cached" lists the hashes
+ * of the files the client has cached (see \a download_file()), the
+ * optional field "manifest" asks for the manifest of the files ahead of
+ * them (see write_manifest()). The optional field "encoding" with the
+ * value "deflate" tells that the client accepts deflated files.
+ *
+ * \param buf the fields of the request [IN]
+ * \param len length of the fields [IN]
+ * \param status_only set if the client asked for a status-only response [OUT]
+ *
+ * \return Information on whether or not the processing was successful
+ * \retval SMSL_E_OK success
+ * \retval SMSL_E_FAILED a general error occured
+ * \retval SMSL_E_INVAL input invalid / not accepted
+ * \retval SMSL_E_OVERFLOW given input exceeds internal buffer size
+ */
+static int process_framed_request(
+    const char *buf,
+    size_t len,
+    int *status_only
+    )
+{
+    static const char * const keywords[] = {
+        "user", "img", "message", "reply", "cached", "encoding", "manifest",
+        "durability"
+    };
+    const char *field[sizeof(keywords) / sizeof(*keywords)];
+    size_t field_len[sizeof(keywords) / sizeof(*keywords)];
+    char request[MAXMESSAGELEN];
+    size_t total;
+    int status;
+
+    *status_only = 0;
+
+    if ((status = parse_fields(
+             buf,
+             len,
+             keywords,
+             sizeof(keywords) / sizeof(*keywords),
+             field,
+             field_len
+             )) != SMSL_E_OK)
+    {
+        return status;
+    }
+
+    *status_only = (field[3] != NULL
+                    && field_len[3] == strlen("status")
+                    && memcmp(field[3], "status", field_len[3]) == 0);
+    cached = field[4];
+    cached_len = field_len[4];
+    deflate_ok = (field[5] != NULL
+                  && field_len[5] == strlen("deflate")
+                  && memcmp(field[5], "deflate", field_len[5]) == 0);
+    manifest_ok = (field[6] != NULL);
+    durability_ok = (field[7] != NULL);
+
+    if ((status = assemble_request(field, field_len, request, &total)) != SMSL_E_OK)
+    {
+        return status;
+    }
+
+    return process_request(request, total);
+}
+
+/**
+ * \brief Process a batch request
+ *
+ * A batch request consists of records, each framed as
+ * "record=<length>\n" followed by the fields "user", the optional "img"
+ * and "message" as in a version 2 request. All records are validated
+ * first, then the accepted ones are posted under a single lock of the
+ * message store by calling \a post_message(). The status of each record
+ * is returned in \a records, the error message is the one of the first
+ * record which failed. The field "durability" may precede the records
+ * to ask for the durability of the posts.
+ *
+ * \param buf the records [IN]
+ * \param len length of the records [IN]
+ * \param records set to the allocated records, to be freed by the
+ * caller, NULL if the batch failed as a whole [OUT]
+ * \param count set to the number of records [OUT]
+ *
+ * \return the status of the first record which failed
+ * \retval SMSL_E_OK all records were posted
+ * \retval SMSL_E_FAILED a general error occured
+ * \retval SMSL_E_INVAL input invalid / not accepted
+ * \retval SMSL_E_OVERFLOW given input exceeds internal buffer size
+ */
+static int process_batch(
+    const char *buf,
+    size_t len,
+    record_t **records,
+    size_t *count
+    )
+{
+    static const char * const keywords[] = { "user", "img", "message" };
+    const char *field[sizeof(keywords) / sizeof(*keywords)];
+    size_t field_len[sizeof(keywords) / sizeof(*keywords)];
+    char firsterror[MAXERRORMSG] = "";
+    char key[MAXKEYLEN];
+    size_t max = len / MINRECORDLEN + 1;
+    size_t pos, value, total, n = 0, used = 0;
+    char *requests;
+    ssize_t hl;
+    int status = SMSL_E_OK;
+
+    *records = NULL;
+    *count = 0;
+
+    if (check_main_page() == -1)
+    {
+        return SMSL_E_FAILED;
+    }
+
+    /*
+     * the reassembled requests are not longer than their records plus
+     * the keywords and newlines
+     */
+    *records = malloc(max * sizeof(**records));
+    requests = malloc(len + max * RECORDOVERHEAD);
+    if (*records == NULL || requests == NULL)
+    {
+        (void) fprintf(
+            stderr,
+            "%s: %s: malloc() failed - %s.\n",
+            cmd,
+            __func__,
+            strerror(errno)
+            );
+        (void) snprintf(errormsg, sizeof(errormsg), "Server out of memory\n");
+        free(*records);
+        free(requests);
+        *records = NULL;
+        return SMSL_E_FAILED;
+    }
+
+    pos = 0;
+    if ((hl = parse_header(buf, len, key, &value)) > 0
+        && value <= len - (size_t) hl
+        && strcmp(key, "durability") == 0)
+    {
+        durability_ok = 1;
+        pos = (size_t) hl + value;
+    }
+
+    for (; pos < len; pos += hl + value, n++)
+    {
+        record_t *record = &(*records)[n];
+
+        if ((hl = parse_header(buf + pos, len - pos, key, &value)) <= 0
+            || value > len - pos - hl
+            || strcmp(key, "record") != 0)
+        {
+            (void) snprintf(
+                errormsg,
+	        sizeof(errormsg),
+                "Malformed batch record at position %zu\n",
+                pos
+                );
+            free(*records);
+            free(requests);
+            *records = NULL;
+            return SMSL_E_INVAL;
+        }
+
+        record->status = parse_fields(
+            buf + pos + hl,
+            value,
+            keywords,
+            sizeof(keywords) / sizeof(*keywords),
+            field,
+            field_len
+            );
+
+        if (record->status == SMSL_E_OK)
+        {
+            record->status = assemble_request(field, field_len, requests + used, &total);
+        }
+
+        if (record->status == SMSL_E_OK)
+        {
+            record->status = prepare_record(requests + used, total, record);
+            used += total + 1;
+        }
+
+        if (record->status != SMSL_E_OK && status == SMSL_E_OK)
+        {
+            status = record->status;
+            (void) strcpy(firsterror, errormsg);
+        }
+    }
+
+    if (post_message(homedir, *records, n) == -1)
+    {
+        for (pos = 0; pos < n && status == SMSL_E_OK; pos++)
+        {
+            status = (*records)[pos].status;  /* the first failed write */
+        }
+        if (firsterror[0] == 0)
+        {
+            (void) strcpy(firsterror, errormsg);
+        }
+    }
+
+    (void) strcpy(errormsg, firsterror);
+    free(requests);
+    *count = n;
+
+    return status;
+}
+
+/**
+ * \brief Write the response to a processed request
+ *
+ * \param session state of the connection [IN/OUT]
+ * \param status execution status of the business logic [IN]
+ * \param status_only write a status-only response [IN]
+ * \param records the records of a batch request or NULL [IN]
+ * \param count number of records [IN]
+ *
+ * \retval 0 success
+ * \retval -1 failed
+ */
+static int respond(
+    smsl_session_t *session,
+    int status,
+    int status_only,
+    const record_t *records,
+    size_t count
+    )
+{
+    int rc;
+
+    if (status != SMSL_E_OK)
+    {
+        session->failed++;
+    }
+
+    if (status_only)
+    {
+        rc = status_response(status, records, count);
+    }
+    else
+    {
+        rc = (status == SMSL_E_OK) ? ok_response(url) : error_response(status);
+    }
+
+    cached = NULL;  /* points into the input of this request */
+    cached_len = 0;
+    deflate_ok = 0;
+    manifest_ok = 0;
+    durability_ok = 0;
+    durability_level = NULL;
+
+    return rc;
+}
+
+/**
+ * \brief Parse a decimal number given as field value
+ *
+ * \param field the value of the field [IN]
+ * \param len length of the value [IN]
+ * \param value set to the number [OUT]
+ *
+ * \retval 0 success
+ * \retval -1 the value is not a number
+ */
+static int parse_number(
+    const char *field,
+    size_t len,
+    size_t *value
+    )
+{
+    size_t i;
+
+    if (len == 0 || len >= MAXFILESIZEDIGITS)
+    {
+        return -1;
+    }
+
+    *value = 0;
+    for (i = 0; i < len; i++)
+    {
+        if (!isdigit((unsigned char) field[i]))
+        {
+            return -1;
+        }
+        *value = *value * 10 + (size_t) (field[i] - '0');
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Close a reader of the message store
+ *
+ * \param reader the reader [IN/OUT]
+ */
+static void close_reader(
+    store_reader_t *reader
+    )
+{
+    if (reader->log_fd != -1)
+    {
+        (void) close(reader->log_fd);
+    }
+    if (reader->table_fd != -1)
+    {
+        (void) close(reader->table_fd);
+    }
+    if (reader->lock_fd != -1)
+    {
+        (void) close(reader->lock_fd);  /* unlock performed automatically with close */
+    }
+    free(reader->buf);
+}
+
+/**
+ * \brief Open the message store for reading under a shared lock
+ *
+ * \param reader the reader, positioned at the end of the store [OUT]
+ *
+ * \retval 0 success
+ * \retval -1 failed, \a errormsg is set
+ */
+static int open_reader(
+    store_reader_t *reader
+    )
+{
+    (void) memset(reader, 0, sizeof(*reader));
+    reader->table_fd = -1;
+    reader->log_fd = -1;
+
+    if (open_store(&reader->lock_fd, &reader->head) == -1)
+    {
+        return -1;
+    }
+
+    reader->seq = reader->head.count;
+    reader->end = reader->head.count;
+
+    if (reader->head.segments > 0
+        && (reader->table_fd = open_store_file(STORE_SEGMENTS_FILE, 0, NULL, O_RDONLY)) == -1)
+    {
+        close_reader(reader);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Position a reader at the first record of a segment
+ *
+ * \param reader the reader [IN/OUT]
+ * \param segment index of the segment in the segment table [IN]
+ *
+ * \retval 0 success
+ * \retval -1 failed, \a errormsg is set
+ */
+static int seek_segment(
+    store_reader_t *reader,
+    uint64_t segment
+    )
+{
+    segment_entry_t entry, following;
+
+    if (read_at(reader->table_fd, &entry, sizeof(entry), segment * sizeof(entry)) == -1
+        || (segment + 1 < reader->head.segments
+            && read_at(
+                   reader->table_fd,
+                   &following,
+                   sizeof(following),
+                   (segment + 1) * sizeof(following)
+                   ) == -1))
+    {
+        return -1;
+    }
+
+    if (reader->log_fd != -1)
+    {
+        (void) close(reader->log_fd);
+    }
+
+    if ((reader->log_fd = open_store_file(NULL, entry.first, SEGMENT_SUFFIX, O_RDONLY)) == -1)
+    {
+        return -1;
+    }
+
+    reader->segment = segment;
+    reader->first = entry.first;
+    reader->end = (segment + 1 < reader->head.segments) ? following.first : reader->head.count;
+    reader->seq = entry.first;
+    reader->offset = 0;
+
+    return 0;
+}
+
+/**
+ * \brief Position a reader at a record or at a point in time
+ *
+ * The segment is found by a binary search in the segment table, the
+ * last indexed record before the wanted one by a lookup (by sequence
+ * number) or a binary search (by time) in the index of the segment,
+ * which leaves less than SEGMENT_INDEX_INTERVAL records to skip.
+ *
+ * \param reader the reader [IN/OUT]
+ * \param by_time nonzero to look for the first record at or after \a value in seconds since the epoch [IN]
+ * \param value sequence number of the record, if not \a by_time [IN]
+ *
+ * \retval 0 success, the reader is positioned at the end if there is no such record
+ * \retval -1 failed, \a errormsg is set
+ */
+static int seek_record(
+    store_reader_t *reader,
+    int by_time,
+    uint64_t value
+    )
+{
+    segment_entry_t segment;
+    index_entry_t entry;
+    record_header_t header;
+    uint64_t lo, hi, mid;
+    int idx_fd, rc = 0;
+
+    reader->seq = reader->head.count;
+    if (reader->head.count == 0 || (!by_time && value >= reader->head.count))
+    {
+        return 0;
+    }
+
+    /*
+     * the last segment starting before the record
+     */
+    lo = 0;
+    hi = reader->head.segments;
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (read_at(reader->table_fd, &segment, sizeof(segment), mid * sizeof(segment)) == -1)
+        {
+            return -1;
+        }
+        if (by_time ? (uint64_t) segment.time < value : segment.first <= value)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    if (seek_segment(reader, (lo > 0) ? lo - 1 : 0) == -1
+        || (idx_fd = open_store_file(NULL, reader->first, INDEX_SUFFIX, O_RDONLY)) == -1)
+    {
+        return -1;
+    }
+
+    /*
+     * the last indexed record before the record
+     */
+    if (by_time)
+    {
+        lo = 0;
+        hi = (reader->end - reader->first + SEGMENT_INDEX_INTERVAL - 1) / SEGMENT_INDEX_INTERVAL;
+        while (lo < hi && rc == 0)
+        {
+            mid = lo + (hi - lo) / 2;
+            if ((rc = read_at(idx_fd, &entry, sizeof(entry), mid * sizeof(entry))) == 0)
+            {
+                if ((uint64_t) entry.time < value)
+                {
+                    lo = mid + 1;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+        }
+        mid = (lo > 0) ? lo - 1 : 0;
+    }
+    else
+    {
+        mid = (value - reader->first) / SEGMENT_INDEX_INTERVAL;
+    }
+
+    if (rc == 0)
+    {
+        rc = read_at(idx_fd, &entry, sizeof(entry), mid * sizeof(entry));
+    }
+    (void) close(idx_fd);
+    if (rc == -1)
+    {
+        return -1;
+    }
+
+    reader->seq = reader->first + mid * SEGMENT_INDEX_INTERVAL;
+    reader->offset = entry.offset;
+
+    /*
+     * skip the records before it, which may end the segment
+     */
+    while (reader->seq < reader->head.count)
+    {
+        if (reader->seq == reader->end && seek_segment(reader, reader->segment + 1) == -1)
+        {
+            return -1;
+        }
+        if (read_at(reader->log_fd, &header, sizeof(header), reader->offset) == -1)
+        {
+            return -1;
+        }
+        if (by_time ? (uint64_t) header.time >= value : reader->seq >= value)
+        {
+            break;
+        }
+        reader->offset += header.len;
+        reader->seq++;
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Read the next record and render it as entry of the bulletin board
+ *
+ * The entry is filled in from the content entry templates and appended
+ * to \a out.
+ *
+ * \param reader the reader, not at the end of the store [IN/OUT]
+ * \param out the rendered entries [IN/OUT]
+ * \param out_len length of \a out [IN/OUT]
+ * \param out_size size of \a out [IN/OUT]
+ *
+ * \retval 0 success
+ * \retval -1 failed, \a errormsg is set
+ */
+static int render_record(
+    store_reader_t *reader,
+    char **out,
+    size_t *out_len,
+    size_t *out_size
+    )
+{
+    const char *with_img = (const char *) content_entry_with_img_thtml;
+    const char *without_img = (const char *) content_entry_without_img_thtml;
+    record_header_t header;
+    size_t body_len, need;
+    char *user, *img, *msg, *p;
     int cnt;
-    const char *user, *img, *msg;
 
-    memset(buf, 0, sizeof(buf));
-    if ((cnt = fread(buf, sizeof(char), sizeof(buf) - 1, stdin)) <= 0)
+    if (reader->seq == reader->end && seek_segment(reader, reader->segment + 1) == -1)
+    {
+        return -1;
+    }
+
+    if (read_at(reader->log_fd, &header, sizeof(header), reader->offset) == -1)
+    {
+        return -1;
+    }
+
+    body_len = (size_t) header.user_len + header.img_len + header.msg_len;
+    if (header.len != sizeof(header) + body_len)
+    {
+        (void) snprintf(
+            errormsg,
+	    sizeof(errormsg),
+            "Record %" PRIu64 " of the bulletin board is corrupt\n",
+            reader->seq
+            );
+        return -1;
+    }
+
+    /*
+     * the fields are read two bytes further and moved down so that
+     * each of them is terminated
+     */
+    if (body_len + 3 > reader->size)
+    {
+        if ((p = realloc(reader->buf, body_len + 3)) == NULL)
+        {
+            (void) snprintf(errormsg, sizeof(errormsg), "Server out of memory\n");
+            return -1;
+        }
+        reader->buf = p;
+        reader->size = body_len + 3;
+    }
+
+    if (read_at(reader->log_fd, reader->buf + 2, body_len, reader->offset + sizeof(header)) == -1)
+    {
+        return -1;
+    }
+
+    user = reader->buf;
+    img = user + header.user_len + 1;
+    msg = img + header.img_len + 1;
+    (void) memmove(user, reader->buf + 2, header.user_len);
+    user[header.user_len] = '\0';
+    (void) memmove(img, reader->buf + 2 + header.user_len, header.img_len);
+    img[header.img_len] = '\0';
+    msg[header.msg_len] = '\0';
+
+    need = sizeof(content_entry_with_img_thtml) + 2 * (size_t) header.user_len + body_len;
+    if (*out_len + need > *out_size)
+    {
+        if ((p = realloc(*out, 2 * (*out_len + need))) == NULL)
+        {
+            (void) snprintf(errormsg, sizeof(errormsg), "Server out of memory\n");
+            return -1;
+        }
+        *out = p;
+        *out_size = 2 * (*out_len + need);
+    }
+
+    /*
+     * in the content entry template we have some %s to fill in
+     * user, image and message.
+     */
+    if (header.img_len > 0)
+    {
+        cnt = snprintf(
+	    *out + *out_len,
+	    need,
+	    with_img,
+	    img,
+	    user,
+	    user,
+	    msg
+            );
+    }
+    else
+    {
+        cnt = snprintf(
+	    *out + *out_len,
+	    need,
+	    without_img,
+	    user,
+	    msg
+            );
+    }
+
+    if (cnt < 0 || (size_t) cnt >= need)
+    {
+        (void) snprintf(
+            errormsg,
+	    sizeof(errormsg),
+            "%s: snprintf() failed - <pre>%s</pre>\n",
+	    cmd,
+            strerror(errno)
+            );
+        return -1;
+    }
+
+    *out_len += (size_t) cnt;
+    reader->offset += header.len;
+    reader->seq++;
+
+    return 0;
+}
+
+/**
+ * \brief Read the comment of a copy of the main page
+ *
+ * \param fd the copy [IN]
+ * \param size size of the copy [IN]
+ * \param from first record on the page [OUT]
+ * \param to record after the last one on the page [OUT]
+ *
+ * \retval 0 the comment matches the copy
+ * \retval -1 it does not, or it cannot be read
+ */
+static int read_page_marker(
+    int fd,
+    uint64_t size,
+    uint64_t *from,
+    uint64_t *to
+    )
+{
+    const char *template = (const char *) vcs_tcpip_bulletin_board_thtml;
+    size_t prefix_len = (size_t) (strstr(template, "%s") - template);
+    char buf[PAGE_MARKER_LEN + 1];
+    uint64_t length;
+    int cnt = 0;
+
+    if (size < prefix_len + PAGE_MARKER_LEN
+        || read_at(fd, buf, PAGE_MARKER_LEN, prefix_len) == -1)
+    {
+        return -1;
+    }
+    buf[PAGE_MARKER_LEN] = '\0';
+
+    if (sscanf(buf, PAGE_MARKER_SCAN, from, to, &length, &cnt) != 3
+        || (size_t) cnt != PAGE_MARKER_LEN - 1
+        || buf[cnt] != '\n'
+        || length != size
+        || *from > *to)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Publish the main page of the bulletin board
+ *
+ * The main page is a static HTML page with the newest entries, the
+ * oldest first, preceded by a comment with the range of their records
+ * and the length of the page. Two copies of it are kept in the message
+ * store, the one published last is linked as main page. The other one,
+ * behind by the entries published last, is updated and renamed over
+ * the main page, so a web server never delivers a partial one: only
+ * the records appended since are rendered and written over the end of
+ * the template, which follows them again, then the comment is updated.
+ * Once a copy would hold more than 2 * PAGE_ENTRIES entries, it is
+ * built anew with the newest PAGE_ENTRIES, as is a copy which does not
+ * match its comment or the store. The directory of the store stays
+ * locked meanwhile, so pages are published in order.
+ *
+ * The posts leave publishing to the publisher (see publish_board()). A
+ * reader which keeps the main page open until it has been published
+ * twice more may see the entries appended to it.
+ *
+ * \retval 0 success
+ * \retval -1 failed, \a errormsg is set
+ */
+static int publish_page(
+    void
+    )
+{
+    const char *template = (const char *) vcs_tcpip_bulletin_board_thtml;
+    size_t prefix_len = (size_t) (strstr(template, "%s") - template);
+    size_t suffix_len = strlen(template) - prefix_len - 2;
+    char marker[PAGE_MARKER_LEN + 1];
+    char name[sizeof(STORE_PAGE_FILE)];
+    char copy_file[MAXPATHLEN];
+    char link_file[MAXPATHLEN];
+    char page_file[MAXPATHLEN];
+    store_reader_t reader;
+    struct stat st, page_st;
+    char *entries = NULL, *p;
+    size_t entries_len = 0, entries_size = 0;
+    uint64_t from, to, old_from, old_to, start, offset, i;
+    int lock_fd, fd = -1, cnt, current, rebuild = 1, rc = 0;
+    int k;
+
+    if (make_store() == -1
+        || store_path(link_file, sizeof(link_file), STORE_PAGE_LINK) == -1
+        || (lock_fd = open_store_file(".", 0, NULL, O_RDONLY | O_DIRECTORY)) == -1)
+    {
+        return -1;
+    }
+
+    if (flock(lock_fd, LOCK_EX) == -1)
+    {
+        (void) snprintf(
+            errormsg,
+	    sizeof(errormsg),
+            "Unable to lock the bulletin board - <pre>%s</pre>\n",
+	    strerror(errno)
+            );
+        (void) close(lock_fd);
+        return -1;
+    }
+
+    cnt = snprintf(
+        page_file,
+        sizeof(page_file),
+        "%s/public_html/%s",
+        homedir,
+        BULLETIN_BOARD_MAIN_FILE
+        );
+    if (cnt < 0 || (size_t) cnt >= sizeof(page_file))
+    {
+        (void) snprintf(errormsg, sizeof(errormsg), "Path of the main page too long\n");
+        (void) close(lock_fd);
+        return -1;
+    }
+
+    if (open_reader(&reader) == -1)
+    {
+        (void) close(lock_fd);
+        return -1;
+    }
+
+    to = reader.head.count;
+    from = to - ((to < PAGE_ENTRIES) ? to : PAGE_ENTRIES);
+    start = from;
+    offset = prefix_len + PAGE_MARKER_LEN;
+
+    /*
+     * the copy which is not the main page is updated, the first one if
+     * neither is
+     */
+    if (stat(page_file, &page_st) == -1)
+    {
+        (void) memset(&page_st, 0, sizeof(page_st));
+    }
+
+    for (k = 0; k < 2; k++)
+    {
+        (void) snprintf(name, sizeof(name), STORE_PAGE_FILE, k);
+        if ((fd = open_store_file(name, 0, NULL, O_RDWR | O_CREAT)) == -1)
+        {
+            rc = -1;
+            break;
+        }
+        if (fstat(fd, &st) == -1)
+        {
+            (void) snprintf(
+                errormsg,
+	        sizeof(errormsg),
+                "Unable to read the main page - <pre>%s</pre>\n",
+	        strerror(errno)
+                );
+            rc = -1;
+            break;
+        }
+        if (st.st_ino != page_st.st_ino || st.st_dev != page_st.st_dev)
+        {
+            break;
+        }
+
+        current = read_page_marker(fd, (uint64_t) st.st_size, &old_from, &old_to) == 0 && old_to == to;
+        (void) close(fd);
+        fd = -1;
+        if (current)
+        {
+            break;  /* published by another process or thread */
+        }
+    }
+
+    if (rc == 0 && fd == -1)
+    {
+        close_reader(&reader);
+        (void) close(lock_fd);
+        return 0;
+    }
+
+    if (rc == 0
+        && read_page_marker(fd, (uint64_t) st.st_size, &old_from, &old_to) == 0
+        && old_to <= to
+        && to - old_from <= 2 * PAGE_ENTRIES
+        && (uint64_t) st.st_size >= offset + suffix_len)
+    {
+        rebuild = 0;
+        from = old_from;
+        start = old_to;
+        offset = (uint64_t) st.st_size - suffix_len;
+    }
+
+    if (rc == 0 && start < to)
+    {
+        rc = seek_record(&reader, 0, start);
+    }
+    for (i = start; i < to && rc == 0; i++)
+    {
+        rc = render_record(&reader, &entries, &entries_len, &entries_size);
+    }
+
+    close_reader(&reader);
+
+    /*
+     * the end of the template follows the entries in the same write
+     */
+    if (rc == 0 && entries_len + suffix_len > entries_size)
+    {
+        if ((p = realloc(entries, entries_len + suffix_len)) == NULL)
+        {
+            (void) snprintf(errormsg, sizeof(errormsg), "Server out of memory\n");
+            rc = -1;
+        }
+        else
+        {
+            entries = p;
+        }
+    }
+
+    if (rc == 0)
+    {
+        (void) memcpy(entries + entries_len, template + prefix_len + 2, suffix_len);
+        entries_len += suffix_len;
+
+        (void) snprintf(marker, sizeof(marker), PAGE_MARKER_FORMAT, from, to, offset + entries_len);
+
+        rc = ((rebuild && write_at(fd, template, prefix_len, 0) == -1)
+              || write_at(fd, entries, entries_len, offset) == -1) ? -1 : 0;
+
+        if (rc == 0 && rebuild && ftruncate(fd, (off_t) (offset + entries_len)) == -1)
+        {
+            (void) snprintf(
+                errormsg,
+	        sizeof(errormsg),
+                "Unable to write the main page - <pre>%s</pre>\n",
+	        strerror(errno)
+                );
+            rc = -1;
+        }
+
+        if (rc == 0)
+        {
+            rc = write_at(fd, marker, PAGE_MARKER_LEN, prefix_len);
+        }
+
+        if (rc == -1)
+        {
+            (void) ftruncate(fd, 0);  /* built anew next time */
+        }
+    }
+
+    /*
+     * the copy is linked under a temporary name, which is renamed over
+     * the main page
+     */
+    if (rc == 0
+        && ((unlink(link_file) == -1 && errno != ENOENT)
+            || store_path(copy_file, sizeof(copy_file), name) == -1
+            || link(copy_file, link_file) == -1
+            || rename(link_file, page_file) == -1))
+    {
+        (void) snprintf(
+            errormsg,
+	    sizeof(errormsg),
+            "Unable to publish the bulletin board - <pre>%s</pre>\n",
+	    strerror(errno)
+            );
+        rc = -1;
+    }
+
+    if (fd != -1)
+    {
+        (void) close(fd);
+    }
+    free(entries);
+    (void) close(lock_fd);  /* unlock performed automatically with close */
+
+    return rc;
+}
+
+/**
+ * \brief Process a fetch request
+ *
+ * A fetch request consists of the optional fields "last", "after" and
+ * "since", framed as in a version 2 request. Without "after" and
+ * "since" the newest "last" entries of the bulletin board are
+ * returned. With "after", a cursor returned by an earlier fetch, the
+ * entries appended since are returned, with "since", seconds since the
+ * epoch, the entries posted since then, the oldest first and at most
+ * "last" of them. At most SMSL_MAXFETCHLEN bytes of whole entries are
+ * returned at once. The message store is read under a shared lock and
+ * the entries are rendered from its records.
+ *
+ * The response consists of the status, the cursor to continue with as
+ * "cursor=<number of records>\n", the entries as
+ * "entries=<length>\n<entries>" and "files=0\n".
+ *
+ * \param session state of the connection [IN/OUT]
+ * \param buf the fields of the request [IN]
+ * \param len length of the fields [IN]
+ *
+ * \retval 0 success
+ * \retval -1 the response could not be written
+ */
+static int process_fetch(
+    smsl_session_t *session,
+    const char *buf,
+    size_t len
+    )
+{
+    static const char * const keywords[] = { "last", "after", "since" };
+    static const char * const fmt_fetched = "cursor=%" PRIu64 "\nentries=%zu\n";
+    static const char * const no_files = "files=0\n";
+    const char *field[sizeof(keywords) / sizeof(*keywords)];
+    size_t field_len[sizeof(keywords) / sizeof(*keywords)];
+    char s[2 * MAXFILESIZEDIGITS + sizeof(fmt_fetched)];
+    size_t last = SIZE_MAX, after = 0, since = 0;
+    uint64_t from, to, end;
+    store_reader_t reader;
+    char *entries = NULL;
+    size_t entries_len = 0, entries_size = 0, start = 0;
+    size_t *starts = NULL;
+    int newest, status;
+
+    if ((status = parse_fields(
+             buf,
+             len,
+             keywords,
+             sizeof(keywords) / sizeof(*keywords),
+             field,
+             field_len
+             )) != SMSL_E_OK)
+    {
+        return respond(session, status, 1, NULL, 0);
+    }
+
+    if ((field[0] != NULL && parse_number(field[0], field_len[0], &last) == -1)
+        || (field[1] != NULL && parse_number(field[1], field_len[1], &after) == -1)
+        || (field[2] != NULL && parse_number(field[2], field_len[2], &since) == -1)
+        || (field[0] == NULL && field[1] == NULL && field[2] == NULL))
+    {
+        (void) snprintf(
+            errormsg,
+	    sizeof(errormsg),
+            "Fetch request needs a number in field <code>last</code>, "
+            "<code>after</code> or <code>since</code>\n"
+            );
+        return respond(session, SMSL_E_INVAL, 1, NULL, 0);
+    }
+
+    if (open_reader(&reader) == -1)
+    {
+        return respond(session, SMSL_E_FAILED, 1, NULL, 0);
+    }
+
+    if (after > reader.head.count)
+    {
+        (void) snprintf(
+            errormsg,
+	    sizeof(errormsg),
+            "Cursor %zu beyond the end of the bulletin board\n",
+            after
+            );
+        close_reader(&reader);
+        return respond(session, SMSL_E_INVAL, 1, NULL, 0);
+    }
+
+    /*
+     * the newest entries are trimmed to SMSL_MAXFETCHLEN from the
+     * oldest one on, so the start of every entry is kept
+     */
+    newest = (field[1] == NULL && field[2] == NULL);
+    if (newest)
+    {
+        to = reader.head.count;
+        from = to - ((last < to) ? last : to);
+        if (to - from > SMSL_MAXFETCHLEN / MINENTRYLEN)
+        {
+            from = to - SMSL_MAXFETCHLEN / MINENTRYLEN;
+        }
+        if (to > from && (starts = malloc((size_t) (to - from) * sizeof(*starts))) == NULL)
+        {
+            (void) snprintf(errormsg, sizeof(errormsg), "Server out of memory\n");
+            close_reader(&reader);
+            return respond(session, SMSL_E_FAILED, 1, NULL, 0);
+        }
+    }
+    else
+    {
+        from = after;
+        if (field[2] != NULL)
+        {
+            if (seek_record(&reader, 1, since) == -1)
+            {
+                close_reader(&reader);
+                return respond(session, SMSL_E_FAILED, 1, NULL, 0);
+            }
+            if (reader.seq > from)
+            {
+                from = reader.seq;
+            }
+        }
+        to = (last < reader.head.count - from) ? from + last : reader.head.count;
+    }
+
+    status = (from < to) ? seek_record(&reader, 0, from) : 0;
+    for (end = from; end < to && status == 0; end++)
+    {
+        if (newest)
+        {
+            starts[end - from] = entries_len;
+        }
+        else
+        {
+            start = entries_len;
+        }
+
+        if ((status = render_record(&reader, &entries, &entries_len, &entries_size)) == 0
+            && !newest && entries_len > SMSL_MAXFETCHLEN)
+        {
+            entries_len = start;  /* continued by the next fetch */
+            break;
+        }
+    }
+
+    close_reader(&reader);
+
+    if (status == -1)
+    {
+        free(starts);
+        free(entries);
+        return respond(session, SMSL_E_FAILED, 1, NULL, 0);
+    }
+
+    start = 0;
+    if (newest)
+    {
+        for (end = from; end < to && entries_len - starts[end - from] > SMSL_MAXFETCHLEN; end++)
+        {
+            ;
+        }
+        start = (end < to) ? starts[end - from] : entries_len;
+        end = to;
+    }
+
+    free(starts);
+
+    (void) snprintf(s, sizeof(s), fmt_fetched, end, entries_len - start);
+
+    status = (write_status(SMSL_E_OK) == -1
+              || write_in_chunks(s, strlen(s)) == -1
+              || (entries_len > start && write_in_chunks(entries + start, entries_len - start) == -1)
+              || write_in_chunks(no_files, strlen(no_files)) == -1) ? -1 : 0;
+
+    free(entries);
+
+    return status;
+}
+
+/**
+ * \brief Process a subscribe request
+ *
+ * A subscribe request has the fields of a fetch request (see
+ * \a process_fetch()). While the bulletin board ends at the cursor
+ * given in "after", it waits for new entries: \a session->wait_until
+ * is set and the request is processed again once the board changed or
+ * SMSL_MAXWAIT seconds have passed. It is then answered as a fetch
+ * request, without entries if none were appended. Without "after" it
+ * is answered right away.
+ *
+ * \param session state of the connection [IN/OUT]
+ * \param buf the fields of the request [IN]
+ * \param len length of the fields [IN]
+ *
+ * \retval 0 success
+ * \retval 1 the request waits for new entries
+ * \retval -1 the response could not be written
+ */
+static int process_subscribe(
+    smsl_session_t *session,
+    const char *buf,
+    size_t len
+    )
+{
+    static const char * const keywords[] = { "after" };
+    const char *field[sizeof(keywords) / sizeof(*keywords)];
+    size_t field_len[sizeof(keywords) / sizeof(*keywords)];
+    store_head_t head;
+    size_t after;
+    int fd;
+    time_t now = time(NULL);
+
+    if (!session->watching)
+    {
+        (void) snprintf(
+            errormsg,
+	    sizeof(errormsg),
+            "Subscribe requests are not supported by this server\n"
+            );
+        return respond(session, SMSL_E_INVAL, 1, NULL, 0);
+    }
+
+    /*
+     * everything malformed is reported by process_fetch()
+     */
+    if (parse_fields(buf, len, keywords, 1, field, field_len) == SMSL_E_OK
+        && field[0] != NULL
+        && parse_number(field[0], field_len[0], &after) == 0
+        && open_store(&fd, &head) == 0
+        && (fd == -1 || close(fd) == 0)
+        && head.count == after
+        && (session->wait_until == 0 || now < session->wait_until))
+    {
+        if (session->wait_until == 0)
+        {
+            session->wait_until = now + SMSL_MAXWAIT;
+        }
+        return 1;
+    }
+
+    session->wait_until = 0;
+
+    return process_fetch(session, buf, len);
+}
+
+/**
+ * \brief Watch the message store of the bulletin board
+ *
+ * \return a non-blocking inotify descriptor
+ * \retval -1 failed
+ */
+static int watch_board(
+    void
+    )
+{
+    char dir[MAXPATHLEN];
+    int fd;
+
+    if (make_store() == -1 || store_path(dir, sizeof(dir), NULL) == -1)
+    {
+        (void) fprintf(
+            stderr,
+            "%s: %s: %s",
+	    cmd,
+	    __func__,
+	    errormsg
+            );
+        return -1;
+    }
+
+    if ((fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1)
+    {
+        (void) fprintf(
+            stderr,
+            "%s: %s: inotify_init1() failed - %s.\n",
+	    cmd,
+	    __func__,
+	    strerror(errno)
+            );
+        return -1;
+    }
+
+    /*
+     * the head file may not exist yet, so the store is watched for
+     * writes to it (it is kept open by the writers)
+     */
+    if (inotify_add_watch(fd, dir, IN_MODIFY) == -1)
+    {
+        (void) fprintf(
+            stderr,
+            "%s: %s: inotify_add_watch() failed - %s.\n",
+	    cmd,
+	    __func__,
+	    strerror(errno)
+            );
+        (void) close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * \brief Consume the events of the watch of the bulletin board
+ *
+ * \param fd the descriptor returned by watch_board() [IN]
+ *
+ * \retval 1 the head of the message store was written
+ * \retval 0 nothing changed
+ * \retval -1 failed
+ */
+static int board_changed(
+    int fd
+    )
+{
+    char events[16 * MAXEVENTLEN]
+        __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *event;
+    ssize_t cnt;
+    size_t pos;
+    int changed = 0;
+
+    while ((cnt = read(fd, events, sizeof(events))) > 0)
+    {
+        for (pos = 0; pos < (size_t) cnt; pos += sizeof(*event) + event->len)
+        {
+            event = (const struct inotify_event *) (events + pos);
+            if ((event->mask & IN_Q_OVERFLOW) != 0
+                || (event->len > 0 && strcmp(event->name, STORE_HEAD_FILE) == 0))
+            {
+                changed = 1;
+            }
+        }
+    }
+
+    if (cnt == -1 && errno != EAGAIN && errno != EINTR)
+    {
+        (void) fprintf(
+            stderr,
+            "%s: %s: read() failed - %s.\n",
+	    cmd,
+	    __func__,
+	    strerror(errno)
+            );
+        return -1;
+    }
+
+    return changed;
+}
+
+/**
+ * \brief Wait until the bulletin board changed or the client sent more
+ *
+ * The watch is set up on the first call, which returns right away, so
+ * the board is checked once more after that and no entry is missed.
+ *
+ * \param in file descriptor the requests are read from, -1 to ignore it [IN]
+ * \param until point in time the wait ends [IN]
+ *
+ * \retval 1 input is ready on \a in
+ * \retval 0 the board changed or the time has passed
+ * \retval -1 failed
+ */
+static int wait_for_board(
+    int in,
+    time_t until
+    )
+{
+    struct pollfd pfd[2];
+    time_t now;
+    int rc;
+
+    if (board_watch == -1)
+    {
+        return ((board_watch = watch_board()) == -1) ? -1 : 0;
+    }
+
+    pfd[0].fd = board_watch;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = in;
+    pfd[1].events = POLLIN;
+
+    while (1)
+    {
+        now = time(NULL);
+        if (now >= until)
+        {
+            return 0;
+        }
+
+        if ((rc = poll(pfd, 2, (int) (until - now) * 1000)) == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            (void) fprintf(
+                stderr,
+                "%s: %s: poll() failed - %s.\n",
+	        cmd,
+	        __func__,
+	        strerror(errno)
+                );
+            return -1;
+        }
+
+        if (pfd[1].revents != 0)
+        {
+            return 1;
+        }
+
+        if (pfd[0].revents != 0 && (rc = board_changed(board_watch)) != 0)
+        {
+            return (rc == -1) ? -1 : 0;
+        }
+    }
+}
+
+/**
+ * \brief Process the input received on a connection
+ *
+ * Determine the protocol version from the first bytes of the
+ * connection and process the complete requests of \a buf. A client
+ * speaking version 2 starts with "version=<n>\n" and is answered with
+ * "version=2\n". Each request is then framed as "request=<length>\n"
+ * followed by its fields (see \a process_framed_request()), as
+ * "batch=<length>\n" followed by its records (see \a process_batch()),
+ * as "fetch=<length>\n" followed by its fields (see \a process_fetch())
+ * or as "subscribe=<length>\n" followed by the same fields (see
+ * \a process_subscribe()). A subscribe request waiting for new entries
+ * is not consumed, it is processed again on the next call. Everything
+ * else is a version 1 request, which ends when the client closes its
+ * sending direction.
+ *
+ * \param session state of the connection [IN/OUT]
+ * \param buf the input not consumed yet [IN]
+ * \param len length of the input [IN]
+ * \param eof nonzero if the client closed its sending direction [IN]
+ *
+ * \return the number of bytes consumed
+ * \retval -1 the input is malformed or truncated or a response failed
+ */
+static ssize_t process_input(
+    smsl_session_t *session,
+    const char *buf,
+    size_t len,
+    int eof
+    )
+{
+    static const char * const kw_version = "version=";
+    static const char * const fmt_version = "version=%d\n";
+    char reply[MAXSTATUSDIGITS + sizeof(fmt_version)];
+    char key[MAXKEYLEN];
+    size_t pos = 0, value, n, count;
+    ssize_t hl;
+    int status, status_only, is_batch, is_fetch, is_subscribe, rc;
+    record_t *records, none;
+
+    if (session->version == 0)
+    {
+        n = (len < strlen(kw_version)) ? len : strlen(kw_version);
+
+        if (len == 0 || strncmp(buf, kw_version, n) != 0)
+        {
+            session->version = 1;
+        }
+        else if ((hl = parse_header(buf, len, key, &value)) == 0 && !eof)
+        {
+            return 0;  /* wait for the rest of the line */
+        }
+        else if (hl > 0 && value >= SMSL_PROTOCOL_VERSION)
+        {
+            (void) snprintf(reply, sizeof(reply), fmt_version, SMSL_PROTOCOL_VERSION);
+            if (write_in_chunks(reply, strlen(reply)) == -1)
+            {
+                return -1;
+            }
+            session->version = SMSL_PROTOCOL_VERSION;
+            pos = hl;
+        }
+        else
+        {
+            session->version = 1;  /* rejected as a malformed request */
+        }
+    }
+
+    version = session->version;
+
+    if (session->version == 1)
     {
-        return SMSL_E_INVAL;  /* nothing read at all */
+        if (!eof && len < MAXMESSAGELEN)
+        {
+            return 0;  /* wait for the end of the request */
+        }
+
+        session->done = 1;
+        if (respond(session, process_plain_request(buf, len), 0, NULL, 0) == -1)
+        {
+            return -1;
+        }
+        return len;
     }
 
-    /*
-     * if we are at EOF the user input is finished. otherwise
-     * there is more input pending which would overflow our internal
-     * buffer.
-     */
-    if (!feof(stdin))
+    while (pos < len)
     {
-        (void) snprintf(
-            errormsg,
-	    sizeof(errormsg),
-	    "Server input buffer overflow - "
-	    "processing of input messages is limited to %u bytes\n",
-	    MAXMESSAGELEN
-            );
-        return SMSL_E_OVERLOW;
+        if (session->skip != 0)
+        {
+            n = (len - pos < session->skip) ? len - pos : session->skip;
+            pos += n;
+            session->skip -= n;
+            continue;
+        }
+
+        if ((hl = parse_header(buf + pos, len - pos, key, &value)) == 0)
+        {
+            break;  /* wait for the rest of the line */
+        }
+
+        is_batch = (hl > 0 && strcmp(key, "batch") == 0);
+        is_fetch = (hl > 0 && strcmp(key, "fetch") == 0);
+        is_subscribe = (hl > 0 && strcmp(key, "subscribe") == 0);
+
+        if (hl == -1 || (strcmp(key, "request") != 0 && !is_batch && !is_fetch && !is_subscribe))
+        {
+            (void) fprintf(
+                stderr,
+                "%s: %s: malformed request header.\n",
+	        cmd,
+	        __func__
+                );
+            return -1;  /* the requests cannot be told apart anymore */
+        }
+
+        if (value > (is_batch ? SMSL_MAXBATCHLEN : SMSL_MAXREQUESTLEN))
+        {
+            (void) snprintf(
+                errormsg,
+	        sizeof(errormsg),
+	        "Server input buffer overflow - "
+	        "processing of requests is limited to %u bytes\n",
+	        is_batch ? SMSL_MAXBATCHLEN : SMSL_MAXREQUESTLEN
+                );
+            if (respond(
+                    session,
+                    SMSL_E_OVERLOW,
+                    is_batch || is_fetch || is_subscribe,
+                    is_batch ? &none : NULL,
+                    0
+                    ) == -1)
+            {
+                return -1;
+            }
+            pos += hl;
+            session->skip = value;
+            continue;
+        }
+
+        if (len - pos - hl < value)
+        {
+            break;  /* wait for the rest of the request */
+        }
+
+        if (is_subscribe)
+        {
+            if ((rc = process_subscribe(session, buf + pos + hl, value)) == 1)
+            {
+                break;  /* wait for new entries */
+            }
+        }
+        else if (is_fetch)
+        {
+            rc = process_fetch(session, buf + pos + hl, value);
+        }
+        else if (is_batch)
+        {
+            /*
+             * the response to a batch is always status-only
+             */
+            status = process_batch(buf + pos + hl, value, &records, &count);
+            rc = respond(session, status, 1, (records != NULL) ? records : &none, (records != NULL) ? count : 0);
+            free(records);
+        }
+        else
+        {
+            status = process_framed_request(buf + pos + hl, value, &status_only);
+            rc = respond(session, status, status_only, NULL, 0);
+        }
+
+        if (rc == -1)
+        {
+            return -1;
+        }
+        pos += hl + value;
+    }
+
+    if (eof && session->wait_until == 0)
+    {
+        if (pos < len || session->skip != 0)
+        {
+            (void) fprintf(
+                stderr,
+                "%s: %s: connection closed within a request.\n",
+	        cmd,
+	        __func__
+                );
+            return -1;
+        }
+        session->done = 1;
+    }
+
+    return pos;
+}
+
+/**
+ * \brief Serve a single client connection
+ *
+ * Read the requests from \a in, process them and write the responses
+ * to \a out until the client closes its sending direction. While a
+ * subscribe request waits for new entries, the bulletin board is
+ * watched along with \a in. The read and write timeouts of the socket
+ * are enforced as deadlines for every request and its responses.
+ *
+ * \param in file descriptor the requests are read from [IN]
+ * \param out file descriptor the responses are written to [IN]
+ *
+ * \retval 0 the messages were posted and the OK responses were sent
+ * \retval -1 a request failed or a response could not be sent
+ */
+static int serve_connection(
+    int in,
+    int out
+    )
+{
+    smsl_session_t session;
+    char buf[SMSL_MAXINPUTLEN];
+    size_t len = 0;
+    ssize_t cnt;
+    int eof = 0;
+    int ready = 0;
+
+    in_fd = in;
+    out_fd = out;
+
+    if (turn_off_nagle_algorithm() == -1)
+    {
+        return -1;
+    }
+
+    memset(&session, 0, sizeof(session));
+    session.watching = 1;
+
+    get_timeouts();
+    arm_deadline(&recv_timeout, &recv_deadline);
+
+    while (!session.done)
+    {
+        if (session.wait_until != 0
+            && (ready = wait_for_board((eof || len == sizeof(buf)) ? -1 : in_fd, session.wait_until)) == -1)
+        {
+            break;
+        }
+
+        if (!eof && (session.wait_until == 0 || ready == 1))
+        {
+            if (limit_to_deadline(in_fd, SO_RCVTIMEO, &recv_deadline) == -1)
+            {
+                cnt = 0;  /* the client did not send the request in time */
+            }
+            else if ((cnt = read(in_fd, buf + len, sizeof(buf) - len)) == -1)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                /* e.g. the read timeout of the server expired */
+                cnt = 0;
+            }
+            eof = (cnt == 0);
+            len += cnt;
+        }
+
+        arm_deadline(&send_timeout, &send_deadline);
+        if ((cnt = process_input(&session, buf, len, eof)) == -1)
+        {
+            break;
+        }
+
+        /* the time for the next request starts, a waiting one is not the client's fault */
+        if (cnt > 0 || session.wait_until != 0)
+        {
+            arm_deadline(&recv_timeout, &recv_deadline);
+        }
+
+        memmove(buf, buf + cnt, len - cnt);
+        len -= cnt;
+
+        if (len == sizeof(buf) && session.wait_until == 0)
+        {
+            break;  /* cannot happen, see smsl_process_input() */
+        }
+    }
+
+    if (board_watch != -1)
+    {
+        (void) close(board_watch);
+        board_watch = -1;
+    }
+
+    return (session.failed == 0 && session.done) ? 0 : -1;
+}
+
+#ifndef SMSL_LIBRARY
+/**
+ * \brief Receive the next client connection from the spawning server
+ *
+ * In pool mode the spawning server passes each accepted socket over
+ * the Unix domain socket \a ctrl (with \a SCM_RIGHTS).
+ *
+ * \param ctrl Unix domain socket connected to the spawning server [IN]
+ *
+ * \return the connected socket
+ * \retval -1 failed or the spawning server closed \a ctrl
+ */
+static int receive_connection(
+    int ctrl
+    )
+{
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsgp;
+    union
+    {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    char byte;
+    ssize_t cnt;
+    int fd;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &byte;
+    iov.iov_len = sizeof(byte);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    while ((cnt = recvmsg(ctrl, &msg, 0)) == -1 && errno == EINTR)
+    {
+        /* retry */
+    }
+
+    if (cnt == -1)
+    {
+	(void) fprintf(
+	    stderr,
+	    "%s: %s: recvmsg() failed - %s.\n",
+	    cmd,
+	    __func__,
+	    strerror(errno)
+	    );
+        return -1;
+    }
+
+    if (cnt == 0)
+    {
+        return -1;  /* the spawning server is gone */
     }
 
+    cmsgp = CMSG_FIRSTHDR(&msg);
+
+    if (cmsgp == NULL ||
+        cmsgp->cmsg_level != SOL_SOCKET ||
+        cmsgp->cmsg_type != SCM_RIGHTS ||
+        cmsgp->cmsg_len != CMSG_LEN(sizeof(int)))
+    {
+	(void) fprintf(
+	    stderr,
+	    "%s: %s: no socket received.\n",
+	    cmd,
+	    __func__
+	    );
+        return -1;
+    }
+
+    memcpy(&fd, CMSG_DATA(cmsgp), sizeof(fd));
+
+    return fd;
+}
+
+/**
+ * \brief Serve the connections passed by the spawning server
+ *
+ * The process is executed and initialised ahead of time and then
+ * serves one connection after the other. After each connection one
+ * byte is sent back on \a stdin to report that the process is idle
+ * again (0 if the message was posted, 1 otherwise).
+ *
+ * \retval 0 the spawning server closed \a stdin
+ * \retval -1 failed
+ */
+static int serve_pool(
+    void
+    )
+{
+    char done;
+    int fd;
+
     /*
-     * if we could not create the main page, we simply discard all the
-     * input from the client and report the error to the client
+     * a client closing its connection must not end the process
      */
-    if (mainpagecreated != 0)
+    (void) signal(SIGPIPE, SIG_IGN);
+
+    while ((fd = receive_connection(STDIN_FILENO)) != -1)
     {
-        (void) snprintf(
-            errormsg,
-	    sizeof(errormsg),
-            "Server could not create main HTML page\n"
-            );
-	return SMSL_E_FAILED;
+        done = (serve_connection(fd, fd) == 0) ? 0 : 1;
+        (void) close(fd);
+
+        if (send(STDIN_FILENO, &done, sizeof(done), MSG_NOSIGNAL) == -1)
+        {
+	    (void) fprintf(
+	        stderr,
+	        "%s: %s: send() failed - %s.\n",
+	        cmd,
+	        __func__,
+	        strerror(errno)
+	        );
+            return -1;
+        }
+    }
+
+    return 0;
+}
+#endif /* SMSL_LIBRARY */
+
+/*
+ * ------------------------------------------------------ library interface --
+ */
+
+int smsl_init(
+    const char *name
+    )
+{
+    cmd = name;
+
+    set_seed_for_random_number_generation();
+
+    if (get_commit_options() == -1)
+    {
+        return -1;
     }
 
-    if (validate_input(buf, cnt) == -1)
+    if (get_url_and_homedir(url, sizeof(url), homedir, sizeof(homedir)) == -1)
     {
-        return SMSL_E_INVAL;    /* input malformed */
+        return -1;
     }
 
-    if (split_input(buf, &user, &img, &msg) == -1)
+    if (import_board() == -1)
     {
-        return SMSL_E_INVAL;    /* input malformed */
+        (void) fprintf(
+            stderr,
+            "%s: %s: Import of the old bulletin board failed - %s",
+	    cmd,
+	    __func__,
+	    errormsg
+            );
     }
 
-    if (post_message(homedir, user, img, msg))
+    mainpagecreated = create_main_page(homedir);
+
+    return 0;
+}
+
+int smsl_handle_connection(
+    int fd
+    )
+{
+    return serve_connection(fd, fd);
+}
+
+int smsl_process_request(
+    const char *req,
+    size_t len,
+    smsl_buffer_t *response
+    )
+{
+    smsl_session_t session;
+    size_t start = response->len;
+    int status;
+    int written;
+
+    memset(&session, 0, sizeof(session));
+    out_buf = response;
+    version = 1;
+
+    status = process_plain_request(req, len);
+    if ((written = respond(&session, status, 0, NULL, 0)) == -1)
     {
-        return SMSL_E_INVAL;    /* write to content file failed */
+        response->len = start;  /* drop the incomplete response */
     }
 
-    return SMSL_E_OK;
+    out_buf = NULL;
+
+    return (status == SMSL_E_OK && written == 0) ? 0 : -1;
+}
+
+int smsl_watch_board(
+    void
+    )
+{
+    return watch_board();
+}
+
+int smsl_sync_board(
+    void
+    )
+{
+    int rc = sync_board();
+
+    return (publish_board() == -1) ? -1 : rc;
+}
+
+int smsl_board_changed(
+    int fd
+    )
+{
+    return board_changed(fd);
+}
+
+ssize_t smsl_process_input(
+    smsl_session_t *session,
+    const char *buf,
+    size_t len,
+    int eof,
+    smsl_buffer_t *response
+    )
+{
+    ssize_t cnt;
+
+    out_buf = response;
+    cnt = process_input(session, buf, len, eof);
+    out_buf = NULL;
+
+    return cnt;
 }
 
+#ifndef SMSL_LIBRARY
+
 /**
  *
  * \brief Main entry point of program.
@@ -1524,11 +6056,11 @@ int main(
     char **argv
     )
 {
-    int c, status;
-    int mainpagecreated = -1;
-    char url[MAXURLLEN], homedir[MAXPATHLEN];
+    int c, rc;
+    int pool = 0;
     struct option long_options[] =
     {
+        {"pool", 0, NULL, 'p'},
         {"help", 0, NULL, 'h'},
         {0, 0, 0, 0}
     };
@@ -1539,7 +6071,7 @@ int main(
 	(c = getopt_long(
 	    argc,
 	    argv,
-	    "h",
+	    "ph",
 	    long_options,
 	    NULL)
 	    ) != -1
@@ -1547,6 +6079,9 @@ int main(
     {
         switch (c)
         {
+            case 'p':
+                pool = 1;
+                break;
             case 'h':
                 usage(stdout, EXIT_SUCCESS);
                 break;
@@ -1587,21 +6122,29 @@ int main(
         assert_files_closed();
     }
 
-    set_seed_for_random_number_generation();
-    turn_off_nagle_algorithm();
+    random_chunks = 1;
 
-    get_url_and_homedir(url, sizeof(url), homedir, sizeof(homedir));
+    if (smsl_init(argv[0]) == -1)
+    {
+        exit(EXIT_FAILURE);
+    }
 
-    mainpagecreated = create_main_page(homedir);
+    rc = pool ? serve_pool() : serve_connection(STDIN_FILENO, STDOUT_FILENO);
 
-    if ((status = process_message(homedir, mainpagecreated)) == SMSL_E_OK)
+    /*
+     * the syncer and the publisher end with the process, which lets the
+     * client see the end of the connection first
+     */
+    if (!pool && testcase != TESTCASE_POSTPONE_COMPLETION)
     {
-        ok_response(url);
+        (void) close(STDIN_FILENO);
+        (void) close(STDOUT_FILENO);
     }
-    else
+    (void) smsl_sync_board();
+
+    if (rc == -1 || pool)
     {
-        error_response(status);
-        return EXIT_FAILURE;
+        exit((rc == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
     }
 
     if (testcase == TESTCASE_POSTPONE_COMPLETION)
@@ -1612,6 +6155,8 @@ int main(
     exit(EXIT_SUCCESS);
 }
 
+#endif /* SMSL_LIBRARY */
+
 /*
  * =================================================================== eof ==
  */
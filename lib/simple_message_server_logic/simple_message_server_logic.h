@@ -0,0 +1,257 @@
+/* ================================================================ */
+/**
+ * @file simple_message_server_logic.h
+ * Business logic for bulletin board programming exercise.
+ *
+ * In the course "Verteilte Computer Systeme" the students shall
+ * implement a bulletin board. It shall consist of a spawning TCP/IP
+ * server which executes the business logic provided by the lector,
+ * and a suitable TCP/IP client.
+ *
+ * This header file contains the interface used to link the business
+ * logic into the server instead of executing it for every connection.
+ */
+/*
+ * $Id:$
+ */
+
+/*
+ * -------------------------------------------------------------- includes --
+ */
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * --------------------------------------------------------------- defines --
+ */
+
+/*
+ * requests of this size or longer are rejected with an overflow error
+ */
+#define SMSL_MAXMESSAGELEN 1024
+
+/*
+ * framed protocol version negotiated by a client starting its
+ * connection with "version=2\n" (everything else is version 1)
+ */
+#define SMSL_PROTOCOL_VERSION 2
+
+/*
+ * room for the list of cached file hashes in a version 2 request
+ * ("cached=<length>\n<hash> <hash> ...", 16 hex digits per hash)
+ */
+#define SMSL_MAXCACHEDLEN 512
+
+/*
+ * version 2 requests with more bytes of fields than this are rejected
+ * with an overflow error
+ */
+#define SMSL_MAXREQUESTLEN (SMSL_MAXMESSAGELEN + SMSL_MAXCACHEDLEN + 64)
+
+/*
+ * version 2 batch requests with more bytes of records than this are
+ * rejected with an overflow error
+ */
+#define SMSL_MAXBATCHLEN 16384
+
+/*
+ * most bytes of bulletin board entries returned for a fetch request
+ */
+#define SMSL_MAXFETCHLEN 65536
+
+/*
+ * seconds a subscribe request waits for new entries at most before it
+ * is answered without any (below the default timeouts of the server)
+ */
+#define SMSL_MAXWAIT 25
+
+/*
+ * input buffer size which holds any complete request of either version
+ * for smsl_process_input()
+ */
+#define SMSL_MAXINPUTLEN (SMSL_MAXBATCHLEN + 64)
+
+/*
+ * status sent without any files by a server turning the client away
+ * because it is at its capacity
+ */
+#define SMSL_STATUS_BUSY 3
+
+/*
+ * -------------------------------------------------------------- typedefs --
+ */
+
+typedef struct
+{
+    char *data;    /* allocated with realloc(), to be freed by the caller */
+    size_t len;    /* number of bytes used */
+    size_t size;   /* number of bytes allocated */
+} smsl_buffer_t;
+
+typedef struct
+{
+    int version;     /* protocol version, 0 until it is known */
+    int done;        /* no further requests are processed */
+    size_t skip;     /* bytes of a rejected request still to be discarded */
+    unsigned failed; /* number of requests which failed */
+    int watching;    /* the caller calls again once the board changed, see smsl_watch_board() */
+    time_t wait_until; /* a subscribe request waits for new entries until then, 0 if none */
+} smsl_session_t;  /* to be zero-initialised for every connection */
+
+/*
+ * ------------------------------------------------- function declarations --
+ */
+
+/**
+ *
+ * \brief Initialise the business logic
+ *
+ * This function determines the URL of the bulletin board web page and
+ * the user's home directory and creates the main page. It has to be
+ * called once before the first call of \a smsl_handle_connection().
+ *
+ * \param name [IN] - name used as prefix of error messages.
+ *
+ * \retval 0 success
+ * \retval -1 failed
+ *
+ */
+extern int smsl_init(
+    const char *name
+    );
+
+/**
+ *
+ * \brief Handle a client connection
+ *
+ * This function reads the client requests from the connected socket
+ * \a fd until the client closes its sending direction, posts the
+ * messages and writes the responses to \a fd. The socket is not closed.
+ *
+ * \param fd [IN] - the connected socket.
+ *
+ * \retval 0 the messages were posted and the OK responses were sent
+ * \retval -1 a request failed or a response could not be sent
+ *
+ */
+extern int smsl_handle_connection(
+    int fd
+    );
+
+/**
+ *
+ * \brief Process a complete client request
+ *
+ * This function processes the request \a req of \a len bytes, i.e.
+ * everything the client sent before closing its sending direction,
+ * and appends the response to \a response instead of writing it to a
+ * socket. This allows event driven servers to do all the I/O. The
+ * function may be called from several threads at the same time.
+ *
+ * \param req [IN] - the request as received from the client.
+ * \param len [IN] - the length of the request.
+ * \param response [IN/OUT] - the buffer the response is appended to.
+ *
+ * \retval 0 the message was posted and the OK response was appended
+ * \retval -1 the request failed and the error response was appended,
+ *         or the response could not be built and nothing was appended
+ *
+ */
+extern int smsl_process_request(
+    const char *req,
+    size_t len,
+    smsl_buffer_t *response
+    );
+
+/**
+ *
+ * \brief Process the input received on a connection
+ *
+ * This function processes as many complete requests of the input
+ * \a buf of \a len bytes as there are and appends their responses to
+ * \a response. The caller discards the bytes consumed, receives more
+ * input and calls it again. A version 1 request is only complete once
+ * the client closed its sending direction (\a eof), version 2 requests
+ * carry their length and may follow each other on the same connection.
+ * \a buf is never filled up with SMSL_MAXINPUTLEN bytes without some of
+ * them being consumed. The function may be called from several threads
+ * at the same time, for different sessions.
+ *
+ * \param session [IN/OUT] - state of the connection.
+ * \param buf [IN] - the input not consumed yet.
+ * \param len [IN] - the length of the input.
+ * \param eof [IN] - nonzero if the client closed its sending direction.
+ * \param response [IN/OUT] - the buffer the responses are appended to.
+ *
+ * \return the number of bytes consumed, the connection can be closed
+ *         once the responses are sent if \a session->done is set
+ * \retval -1 the input is malformed or truncated, or a response could
+ *         not be built; the connection has to be closed
+ *
+ */
+extern ssize_t smsl_process_input(
+    smsl_session_t *session,
+    const char *buf,
+    size_t len,
+    int eof,
+    smsl_buffer_t *response
+    );
+
+/**
+ *
+ * \brief Watch the bulletin board for new entries
+ *
+ * This function returns a non-blocking descriptor which becomes
+ * readable whenever entries are appended to the bulletin board, i.e.
+ * when \a post_message() writes the head of the message store. An
+ * event driven server polls it together with its sockets and sets
+ * \a watching in the session of every connection. A subscribe request
+ * which waits for new entries leaves \a wait_until set after
+ * \a smsl_process_input() returned. The server then calls it again
+ * for the connection, without new input, once \a smsl_board_changed()
+ * reported a change or \a wait_until has passed.
+ *
+ * \return the descriptor, to be closed by the caller
+ * \retval -1 failed
+ *
+ */
+extern int smsl_watch_board(
+    void
+    );
+
+/**
+ *
+ * \brief Consume the events of the board watch
+ *
+ * \param fd [IN] - the descriptor returned by \a smsl_watch_board().
+ *
+ * \retval 1 entries were appended since the last call
+ * \retval 0 nothing changed
+ * \retval -1 failed
+ *
+ */
+extern int smsl_board_changed(
+    int fd
+    );
+
+/**
+ *
+ * \brief Sync the posts which are not synced yet and publish the main page
+ *
+ * With SMSL_DURABILITY=periodic, posts are synced by a background
+ * thread, and the main page is published by another one after every
+ * post; both end with the process. A process which has handled
+ * connections calls this function before it exits.
+ *
+ * \retval 0 success or nothing to do
+ * \retval -1 failed
+ *
+ */
+extern int smsl_sync_board(
+    void
+    );
+
+/*
+ * =================================================================== eof ==
+ */
@@ -1,4 +1,4 @@
-static const unsigned char vcs_tcpip_bulletin_board_php[] = {
+static const unsigned char vcs_tcpip_bulletin_board_thtml[] = {
 0x3c, 0x21, 0x44, 0x4f, 0x43, 0x54, 0x59, 0x50, 0x45, 0x20, 0x68, 0x74, 
 0x6d, 0x6c, 0x20, 0x50, 0x55, 0x42, 0x4c, 0x49, 0x43, 0x20, 0x22, 0x2d, 
 0x2f, 0x2f, 0x57, 0x33, 0x43, 0x2f, 0x2f, 0x44, 0x54, 0x44, 0x20, 0x58, 
@@ -57,22 +57,6 @@ static const unsigned char vcs_tcpip_bulletin_board_php[] = {
 0x3d, 0x22, 0x74, 0x63, 0x70, 0x69, 0x62, 0x75, 0x6c, 0x6c, 0x65, 0x74, 
 0x69, 0x6e, 0x22, 0x2f, 0x3e, 0x42, 0x75, 0x6c, 0x6c, 0x65, 0x74, 0x69, 
 0x6e, 0x20, 0x42, 0x6f, 0x61, 0x72, 0x64, 0x3c, 0x2f, 0x68, 0x32, 0x3e, 
-0x0a, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x3c, 0x3f, 0x70, 0x68, 0x70, 0x0a, 
-0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x24, 0x66, 0x6e, 0x3d, 0x22, 0x62, 
-0x75, 0x6c, 0x6c, 0x65, 0x74, 0x69, 0x6e, 0x5f, 0x62, 0x6f, 0x61, 0x72, 
-0x64, 0x5f, 0x63, 0x6f, 0x6e, 0x74, 0x65, 0x6e, 0x74, 0x2e, 0x64, 0x61, 
-0x74, 0x22, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x24, 0x66, 
-0x69, 0x6c, 0x65, 0x3d, 0x66, 0x6f, 0x70, 0x65, 0x6e, 0x28, 0x24, 0x66, 
-0x6e, 0x2c, 0x20, 0x22, 0x72, 0x22, 0x29, 0x3b, 0x0a, 0x20, 0x20, 0x20, 
-0x20, 0x20, 0x20, 0x66, 0x6c, 0x6f, 0x63, 0x6b, 0x28, 0x24, 0x66, 0x69, 
-0x6c, 0x65, 0x2c, 0x20, 0x4c, 0x4f, 0x43, 0x4b, 0x5f, 0x53, 0x48, 0x29, 
-0x3b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x63, 0x6c, 
-0x75, 0x64, 0x65, 0x28, 0x24, 0x66, 0x6e, 0x29, 0x3b, 0x0a, 0x20, 0x20, 
-0x20, 0x20, 0x20, 0x20, 0x66, 0x6c, 0x6f, 0x63, 0x6b, 0x28, 0x24, 0x66, 
-0x69, 0x6c, 0x65, 0x2c, 0x20, 0x4c, 0x4f, 0x43, 0x4b, 0x5f, 0x55, 0x4e, 
-0x29, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x66, 0x63, 0x6c, 
-0x6f, 0x73, 0x65, 0x28, 0x24, 0x66, 0x69, 0x6c, 0x65, 0x29, 0x3b, 0x0a, 
-0x20, 0x20, 0x20, 0x20, 0x3f, 0x3e, 0x0a, 0x20, 0x20, 0x3c, 0x2f, 0x62, 
-0x6f, 0x64, 0x79, 0x3e, 0x0a, 0x3c, 0x2f, 0x68, 0x74, 0x6d, 0x6c, 0x3e, 
-0x0a, 0x0a, 0x00, 
+0x0a, 0x0a, 0x25, 0x73, 0x20, 0x20, 0x3c, 0x2f, 0x62, 0x6f, 0x64, 0x79, 
+0x3e, 0x0a, 0x3c, 0x2f, 0x68, 0x74, 0x6d, 0x6c, 0x3e, 0x0a, 0x0a, 0x00, 
 };
@@ -0,0 +1,55 @@
+static const unsigned char vcs_tcpip_bulletin_board_response_error_thtml_z[] = {
+0x8c, 0x92, 0xc1, 0x6e, 0x9c, 0x30, 0x10, 0x86, 0xef, 0x3c, 0xc5, 0xd4, 
+0x87, 0xde, 0xc0, 0x5d, 0x45, 0x91, 0xd2, 0x16, 0x36, 0xd2, 0xb2, 0x5b, 
+0x15, 0x29, 0x4d, 0x56, 0x09, 0x4d, 0xdb, 0xa3, 0x03, 0xb3, 0xd8, 0x8a, 
+0x31, 0xd4, 0x1e, 0xc2, 0x6e, 0x9e, 0xbe, 0x66, 0x61, 0x13, 0x22, 0xf5, 
+0x10, 0x4e, 0x9e, 0x19, 0xff, 0xdf, 0x3f, 0x33, 0x26, 0xbe, 0xdc, 0xd7, 
+0x1a, 0x9e, 0xd0, 0x3a, 0xd5, 0x98, 0x84, 0x2d, 0xa2, 0x4f, 0x0c, 0xd0, 
+0x14, 0x4d, 0xa9, 0x4c, 0x95, 0xb0, 0xec, 0xee, 0x26, 0xbc, 0xb8, 0x38, 
+0xff, 0x1c, 0x2e, 0xce, 0xd9, 0xe5, 0x32, 0x88, 0x3f, 0xac, 0x6f, 0xd2, 
+0xfc, 0xcf, 0x76, 0x03, 0x92, 0xbc, 0x6a, 0xfb, 0x73, 0x75, 0x95, 0xa5, 
+0xc0, 0x42, 0xce, 0x7f, 0x9d, 0xa5, 0x9c, 0xaf, 0xf3, 0x35, 0xfc, 0xfe, 
+0x9e, 0xff, 0xb8, 0x02, 0x8f, 0x81, 0xdc, 0x0a, 0xe3, 0x14, 0x79, 0xac, 
+0xd0, 0x9c, 0x6f, 0xae, 0x59, 0xc0, 0x24, 0x51, 0xfb, 0x85, 0xf3, 0xbe, 
+0xef, 0xa3, 0xfe, 0x2c, 0x6a, 0x6c, 0xc5, 0xf3, 0x5b, 0xbe, 0x1f, 0x58, 
+0x8b, 0x41, 0x3c, 0x1d, 0x43, 0x9a, 0x29, 0xa3, 0x92, 0x4a, 0xe6, 0x9d, 
+0x87, 0xca, 0x32, 0x00, 0x88, 0x25, 0x8a, 0x72, 0x38, 0xf8, 0x63, 0x8d, 
+0x24, 0x60, 0x60, 0x86, 0xf8, 0xb7, 0x53, 0x4f, 0x09, 0x4b, 0x1b, 0x43, 
+0x68, 0x28, 0xcc, 0x0f, 0x2d, 0x32, 0x28, 0xc6, 0x28, 0x61, 0x84, 0x7b, 
+0xe2, 0x03, 0xe0, 0x6b, 0x50, 0x48, 0x61, 0x1d, 0x52, 0x32, 0x1f, 0x0c, 
+0xf8, 0xc4, 0xd3, 0xca, 0x3c, 0x82, 0x45, 0x9d, 0x30, 0x47, 0x07, 0x8d, 
+0x4e, 0x22, 0x12, 0x03, 0xf2, 0xb0, 0x89, 0x51, 0x38, 0xc7, 0x40, 0x5a, 
+0xdc, 0xf9, 0xb8, 0x68, 0x55, 0x1b, 0x1d, 0x13, 0x27, 0x39, 0x29, 0xd2, 
+0xb8, 0xbc, 0x47, 0x4b, 0xa8, 0x34, 0x21, 0xa4, 0x4d, 0xdd, 0x76, 0xe4, 
+0x37, 0x7b, 0x70, 0x84, 0x35, 0x42, 0x08, 0x79, 0xba, 0xe5, 0xd9, 0x16, 
+0xc2, 0xe0, 0x16, 0x5d, 0xdb, 0x18, 0x87, 0x31, 0x1f, 0x45, 0xc3, 0x60, 
+0xfc, 0x34, 0x59, 0xfc, 0xd0, 0x94, 0x87, 0x89, 0x29, 0xed, 0x89, 0x5e, 
+0xf8, 0x51, 0xd0, 0x8e, 0xc1, 0xb1, 0xb2, 0x78, 0x97, 0x15, 0xbc, 0x5a, 
+0x79, 0xc5, 0x88, 0xe2, 0x73, 0xd6, 0xcc, 0x82, 0xc4, 0xc3, 0xd8, 0xcb, 
+0xe8, 0x40, 0xd3, 0x9e, 0x21, 0x56, 0x75, 0x05, 0xce, 0x16, 0x09, 0x43, 
+0x6b, 0x1b, 0x1b, 0xb5, 0xa6, 0x62, 0x20, 0xb4, 0xdf, 0xec, 0x66, 0x88, 
+0x21, 0xab, 0x45, 0x85, 0xec, 0x55, 0xc8, 0x5f, 0x94, 0x47, 0x8a, 0xbf, 
+0xaa, 0x2a, 0x93, 0x68, 0xdc, 0xd1, 0x4b, 0xda, 0x17, 0xda, 0xff, 0xe7, 
+0xfd, 0xb7, 0x71, 0xa0, 0x1c, 0x01, 0x2a, 0x03, 0xdf, 0x50, 0x6a, 0xb4, 
+0x20, 0xba, 0x5d, 0x85, 0x64, 0xd1, 0xbf, 0x67, 0x04, 0x99, 0x7f, 0x01, 
+0xb8, 0x16, 0x85, 0xb4, 0xaa, 0x90, 0x04, 0x8f, 0x8d, 0xf1, 0xd3, 0xbc, 
+0x01, 0x98, 0x63, 0xa1, 0xc4, 0x1a, 0xee, 0xd3, 0xbb, 0xd3, 0x2a, 0x56, 
+0x9d, 0xd6, 0x48, 0x9e, 0xb9, 0x6a, 0x84, 0x2d, 0xdf, 0xdc, 0x97, 0xca, 
+0x3c, 0x77, 0x15, 0xee, 0x3e, 0x76, 0x9d, 0xff, 0x49, 0x2a, 0x82, 0x1e, 
+0x6d, 0xe9, 0xad, 0x66, 0xdd, 0xf2, 0xf6, 0x7d, 0xbd, 0xff, 0x03, 0x00, 
+0x00, 0xff, 0xff, 0x84, 0x8d, 0xcb, 0x0a, 0xc2, 0x30, 0x10, 0x45, 0xf7, 
+0xf9, 0x8a, 0xd0, 0xbd, 0xcd, 0x5e, 0x62, 0x10, 0x04, 0x5d, 0xb9, 0xeb, 
+0x0f, 0x4c, 0x9a, 0xd4, 0x19, 0xcc, 0x43, 0x92, 0x11, 0xf1, 0xef, 0x7d, 
+0x35, 0x82, 0x50, 0x70, 0x56, 0xe7, 0xc2, 0x9d, 0x7b, 0x84, 0x6c, 0xa7, 
+0xd5, 0xc5, 0x88, 0x2f, 0xb3, 0xfb, 0x84, 0x27, 0x81, 0x0d, 0x7e, 0x0e, 
+0x58, 0xd4, 0x4c, 0xe0, 0x5c, 0xf1, 0xb5, 0xb6, 0x0f, 0x0d, 0x12, 0x8b, 
+0x9f, 0x36, 0x5d, 0x04, 0x0a, 0x9c, 0xd7, 0x27, 0x08, 0x01, 0xb6, 0xec, 
+0x47, 0x4c, 0x74, 0xbe, 0xc6, 0xd5, 0x8d, 0x7c, 0xea, 0x81, 0x3b, 0x33, 
+0x60, 0x8e, 0x50, 0xe5, 0xb1, 0x97, 0x87, 0x57, 0x45, 0x2b, 0x68, 0x9e, 
+0x9f, 0xc5, 0x7f, 0xfb, 0x13, 0x59, 0x1a, 0x71, 0x49, 0xb0, 0xc3, 0x42, 
+0x95, 0x09, 0x92, 0xdc, 0xbf, 0x3b, 0xcb, 0x06, 0xad, 0x6c, 0x76, 0x77, 
+0x23, 0xb4, 0x42, 0x8e, 0xc1, 0x88, 0x07, 0x00, 0x00, 0x00, 0xff, 0xff, 
+};
+static const unsigned long vcs_tcpip_bulletin_board_response_error_thtml_z_parts[] = {
+459, 600, 
+};
@@ -0,0 +1,58 @@
+static const unsigned char vcs_tcpip_bulletin_board_response_ok_thtml_z[] = {
+0x8c, 0x93, 0x4d, 0x6f, 0x9b, 0x40, 0x10, 0x86, 0xef, 0xfe, 0x15, 0xd3, 
+0x3d, 0xf4, 0x06, 0x5b, 0x2b, 0x8a, 0x94, 0xa6, 0xe0, 0x48, 0xc6, 0x91, 
+0x8a, 0xea, 0xc6, 0x96, 0x4d, 0xd2, 0xf6, 0xb8, 0x81, 0x01, 0x56, 0x59, 
+0x16, 0xba, 0x3b, 0x04, 0x3b, 0xbf, 0xbe, 0x8b, 0xc1, 0x09, 0x95, 0xaa, 
+0x2a, 0x9c, 0xe6, 0x63, 0xdf, 0xe7, 0xdd, 0x19, 0x20, 0xb8, 0x39, 0x54, 
+0x0a, 0x9e, 0xd1, 0x58, 0x59, 0xeb, 0x90, 0xcd, 0xfd, 0x4f, 0x0c, 0x50, 
+0xa7, 0x75, 0x26, 0x75, 0x11, 0xb2, 0x78, 0xbf, 0xf1, 0xae, 0xae, 0x2e, 
+0x3f, 0x7b, 0xf3, 0x4b, 0x76, 0xb3, 0x98, 0x05, 0x1f, 0x56, 0x9b, 0x28, 
+0xf9, 0xb5, 0xbd, 0x85, 0x92, 0x9c, 0x6a, 0x7b, 0xbf, 0x5c, 0xc7, 0x11, 
+0x30, 0x8f, 0xf3, 0x1f, 0x17, 0x11, 0xe7, 0xab, 0x64, 0x05, 0x3f, 0xbf, 
+0x26, 0xdf, 0xd7, 0xe0, 0x30, 0x90, 0x18, 0xa1, 0xad, 0x24, 0x87, 0x15, 
+0x8a, 0xf3, 0xdb, 0x3b, 0x36, 0x63, 0x25, 0x51, 0x73, 0xcd, 0x79, 0xd7, 
+0x75, 0x7e, 0x77, 0xe1, 0xd7, 0xa6, 0xe0, 0xc9, 0x8e, 0x1f, 0x7a, 0xd6, 
+0xbc, 0x17, 0x8f, 0xa1, 0x47, 0x13, 0xa5, 0x9f, 0x51, 0xc6, 0x9c, 0x73, 
+0xdf, 0x59, 0xcc, 0x00, 0x82, 0x12, 0x45, 0xd6, 0x07, 0x2e, 0xac, 0x90, 
+0x04, 0xf4, 0x4c, 0x0f, 0x7f, 0xb7, 0xf2, 0x39, 0x64, 0x51, 0xad, 0x09, 
+0x35, 0x79, 0xc9, 0xb1, 0x41, 0x06, 0xe9, 0x90, 0x85, 0x8c, 0xf0, 0x40, 
+0xbc, 0x07, 0x7c, 0x99, 0xa5, 0xa5, 0x30, 0x16, 0x29, 0x9c, 0x0e, 0x06, 
+0x7c, 0xe4, 0x29, 0xa9, 0x9f, 0xc0, 0xa0, 0x0a, 0x99, 0xa5, 0xa3, 0x42, 
+0x5b, 0x22, 0x12, 0x03, 0x72, 0xb0, 0x91, 0x91, 0x5a, 0xcb, 0xa0, 0x34, 
+0x98, 0xbb, 0x3c, 0x6d, 0x64, 0xe3, 0x9f, 0x0a, 0x67, 0x39, 0x49, 0x52, 
+0xb8, 0x78, 0x40, 0x43, 0x28, 0x15, 0x21, 0x44, 0x75, 0xd5, 0xb4, 0xe4, 
+0x36, 0x7b, 0xb4, 0x84, 0x15, 0x82, 0x07, 0x49, 0xb4, 0xe5, 0xf1, 0x16, 
+0xbc, 0xd9, 0x0e, 0x6d, 0x53, 0x6b, 0x8b, 0x01, 0x1f, 0x44, 0xfd, 0x60, 
+0xfc, 0x3c, 0x59, 0xf0, 0x58, 0x67, 0xc7, 0x91, 0x59, 0x9a, 0x33, 0x3d, 
+0x75, 0xa3, 0xa0, 0x19, 0x92, 0x53, 0x67, 0xfe, 0x2e, 0x2b, 0x78, 0xb3, 
+0x72, 0x8a, 0x01, 0xc5, 0xa7, 0xac, 0x89, 0x05, 0x89, 0xc7, 0xe1, 0x2e, 
+0x83, 0x03, 0x8d, 0x7b, 0x86, 0x40, 0x56, 0x05, 0x58, 0x93, 0x86, 0xac, 
+0x7e, 0xf2, 0x1b, 0x5d, 0x30, 0x10, 0xca, 0xad, 0x75, 0xf3, 0x0d, 0xe2, 
+0x4a, 0x14, 0xc8, 0xde, 0x24, 0xfc, 0x55, 0x73, 0xd2, 0xbb, 0x73, 0xb2, 
+0xd0, 0xa1, 0xc2, 0x9c, 0x5e, 0xcb, 0xae, 0xd1, 0xfc, 0xbb, 0xee, 0x9e, 
+0xd8, 0x2d, 0x17, 0xee, 0x44, 0x5a, 0x1a, 0x99, 0x96, 0x04, 0x5d, 0x6b, 
+0x32, 0x04, 0x34, 0x79, 0xad, 0x0a, 0x83, 0xae, 0x04, 0x19, 0x56, 0xf0, 
+0x10, 0xed, 0xc7, 0xf1, 0xfe, 0xd2, 0x2e, 0x5b, 0xa5, 0x90, 0xa4, 0x86, 
+0x65, 0x2d, 0x4c, 0x06, 0xa5, 0xd4, 0x2f, 0x6d, 0x81, 0xf9, 0xc7, 0xb6, 
+0x75, 0x2f, 0xbe, 0x20, 0x1f, 0xf6, 0x12, 0x21, 0x97, 0x3a, 0x43, 0x0d, 
+0x99, 0xb0, 0xff, 0xd3, 0xb6, 0xfd, 0x7a, 0xa0, 0x77, 0x45, 0x77, 0xdc, 
+0xc0, 0xfd, 0x6e, 0x7d, 0x3d, 0xb9, 0x3f, 0x6f, 0xde, 0x37, 0x4d, 0xe0, 
+0x7e, 0x23, 0x5c, 0x04, 0x62, 0xfc, 0x64, 0xfe, 0x00, 0x00, 0x00, 0xff, 
+0xff, 0x52, 0xb2, 0x03, 0x00, 0x00, 0x00, 0xff, 0xff, 0x84, 0x8e, 0xc1, 
+0x0a, 0xc2, 0x30, 0x10, 0x44, 0xef, 0xfd, 0x8a, 0xd0, 0xbb, 0xdd, 0xbb, 
+0xac, 0x41, 0x10, 0xf4, 0xe4, 0xcd, 0x1f, 0xd8, 0x26, 0xa9, 0xbb, 0x98, 
+0x34, 0x92, 0x44, 0xc4, 0xbf, 0xb7, 0x6a, 0x2a, 0x08, 0x05, 0xf7, 0x34, 
+0x03, 0x6f, 0x67, 0x06, 0x81, 0x34, 0x82, 0x89, 0xd6, 0xe9, 0x46, 0xcd, 
+0x87, 0x70, 0xfd, 0x3a, 0x84, 0x62, 0x3f, 0x66, 0x52, 0xd4, 0xfb, 0xca, 
+0x21, 0x27, 0xa8, 0x8a, 0xac, 0x4d, 0x2e, 0xe7, 0xf9, 0x03, 0x49, 0x71, 
+0x72, 0xc3, 0xa6, 0x0d, 0x24, 0xbe, 0xc4, 0xf5, 0x99, 0xbc, 0xa7, 0x6d, 
+0x71, 0x86, 0x47, 0xb9, 0xdc, 0xc2, 0xea, 0x2e, 0x6e, 0xec, 0xa8, 0xb4, 
+0xfa, 0xc4, 0x31, 0x50, 0x56, 0xc7, 0x4e, 0x1d, 0x5e, 0x08, 0x4e, 0x4b, 
+0x6a, 0xcf, 0x4f, 0xe2, 0xbf, 0xfc, 0x41, 0x7a, 0x31, 0xbc, 0x54, 0xb0, 
+0xe3, 0x24, 0xb9, 0x08, 0x8d, 0x6a, 0xff, 0x66, 0x96, 0x1b, 0x10, 0xfa, 
+0x68, 0x1f, 0xba, 0x41, 0xe0, 0x12, 0xbc, 0x6e, 0x9e, 0x00, 0x00, 0x00, 
+0xff, 0xff, 
+};
+static const unsigned long vcs_tcpip_bulletin_board_response_ok_thtml_z_parts[] = {
+469, 477, 626, 
+};
@@ -1,28 +1,114 @@
-#include "simple_message_client_commandline_handling.h"
+#define _GNU_SOURCE /* fallocate() */
+
+#include <dirent.h>
 #include <err.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
 #include <netdb.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include <zlib.h>
 
 #ifndef NAME_MAX
 #define NAME_MAX 255
 #endif
 
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
 #define v(fmt, ...)                                                                                          \
   if (verbose)                                                                                               \
     fprintf(stderr, "%s(): " fmt, __func__, __VA_ARGS__);
 
-typedef enum { GET_STATUS, GET_FILE, GET_LEN, GET_DATA } parsing;
+#define PROTOCOL_VERSION 2
+#define DEFAULT_WINDOW 16
+#define MAX_WINDOW 32 /* the requests in flight must fit into the socket buffers, see post_lines() */
+#define MAX_BATCH 1024
+#define BATCH_LIMIT 16384 /* bytes of records in a batch request, see SMSL_MAXBATCHLEN */
+#define BATCH_DURABILITY "durability=3\nyes" /* ahead of the records of a batch */
+#define HASH_LEN 16   /* hex digits of the 64 bit FNV-1a hash naming a cached file */
+#define MAX_CACHED 16 /* hashes announced to the server, the list must fit into SMSL_MAXCACHEDLEN */
+#define MAX_MANIFEST 8 /* files opened ahead of their contents */
+
+typedef struct {
+  const char *server;
+  const char *port;
+  const char *user;
+  const char *message;
+  const char *img_url;
+  long window;     /* requests sent ahead of their responses */
+  long batch;      /* messages per batch request */
+  long last;       /* entries to fetch, -1 if not fetching */
+  long after;      /* cursor to fetch the entries after, -1 for the newest */
+  long since;      /* seconds since the epoch to fetch the entries posted since, -1 for the newest */
+  int status_only; /* ask for responses without files */
+  int follow;      /* subscribe to the entries appended after the fetched ones */
+  int version;     /* protocol version, 0 until given or implied by fetching */
+} options_t;
+
+typedef struct {
+  char *data; /* the records */
+  size_t len;
+  long records;
+  long first; /* line of the first record */
+} batch_t;
+
+typedef struct {
+  const char *dir; /* NULL if caching is off */
+  char hashes[MAX_CACHED][HASH_LEN + 1];
+  size_t count;
+} cache_t;
+
+typedef struct {
+  char names[MAX_MANIFEST][NAME_MAX];
+  FILE *files[MAX_MANIFEST]; /* NULL once the file is received */
+  size_t count;
+} manifest_t;
 
 static int verbose = 0;
+static cache_t cache;
+static manifest_t manifest;
+static long cursor = -1; /* where the entries received last end */
 
 static void usage(FILE *stream, const char *cmd, int code);
+static int parse_params(int argc, char *argv[], options_t *options);
 static int connection(const char *server, const char *port);
-static int request(FILE *write_fd, int sock, const char *user, const char *message, const char *img_url);
-static int response(FILE *read_fd);
+static int open_session(const char *server, const char *port, int *version, FILE **read_fd, FILE **write_fd);
+static void close_session(FILE *read_fd, FILE *write_fd);
+static int negotiate(FILE *read_fd, int sock);
+static int fetch(FILE *read_fd, FILE *write_fd, int version, const options_t *options);
+static int post(FILE *read_fd, FILE *write_fd, int version, const options_t *options, const char *message);
+static int post_lines(const options_t *options, int version, FILE **read_fd, FILE **write_fd);
+static int collect_response(FILE *read_fd, FILE *write_fd, int version, long first_line, int *result);
+static int request(FILE *write_fd, int version, const options_t *options, const char *message);
+static int request_framed(FILE *write_fd, const options_t *options, const char *message);
+static int add_record(batch_t *batch, const options_t *options, const char *message, long line);
+static int request_batch(FILE *write_fd, batch_t *batch);
+static int build_fields(const options_t *options, const char *message, int record, char **buf, size_t *len);
+static int write_field(FILE *fields, const char *key, const char *value);
+static int response(FILE *read_fd, int version, long first_line);
+static int receive_error(FILE *read_fd, char *line);
+static int receive_results(FILE *read_fd, char *line, long first_line);
+static int receive_entries(FILE *read_fd, char *line);
+static int receive_manifest(FILE *read_fd, char *line);
+static FILE *manifest_file(const char *file_name);
+static void close_manifest(void);
+static int receive_file(FILE *read_fd, char **line, size_t *line_len);
+static int receive_data(FILE *read_fd, FILE *fp, long file_len, int deflated, unsigned long long *hash_value);
+static int inflate_chunk(z_stream *strm, FILE *fp, unsigned long long *hash_value);
+static int cache_open(const char *dir);
+static int cache_add(const char *hash);
+static int cache_fetch(const char *hash, const char *file_name);
+static void cache_store(const char *hash, const char *file_name);
+static int unshare_file(const char *file_name);
+static int copy_file(const char *from, const char *to);
+static unsigned long long hash_update(unsigned long long hash, const char *buf, size_t len);
 static int parse_string(char *line, const char *key, char *result, const size_t result_len);
 static int parse_long(char *line, const char *key, long *result);
 
@@ -34,54 +120,54 @@ static int parse_long(char *line, const char *key, long *result);
  *
  * @returns EXIT_SUCCESS, EXIT_FAILURE
  */
-int main(int argc, const char *argv[]) {
-  smc_usagefunc_t usagefunc = usage;
-  const char *server = NULL;
-  const char *port = NULL;
-  const char *user = NULL;
-  const char *message = NULL;
-  const char *img_url = NULL;
-  int sock = -1;
+int main(int argc, char *argv[]) {
+  options_t options = {NULL, NULL, NULL, NULL, NULL, DEFAULT_WINDOW, 1, -1, -1, -1, 0, 0, 0};
   int status = 1;
+  int version;
   FILE *write_fd = NULL;
   FILE *read_fd = NULL;
 
-  smc_parsecommandline(argc, argv, usagefunc, &server, &port, &user, &message, &img_url, &verbose);
-  v("server: %s, port: %s, user: %s, message: %s, img_url: %s\n", server, port, user, message, img_url);
-
-  if ((sock = connection(server, port)) == -1) {
-    /* error is printed by connection() */
-    return EXIT_FAILURE;
+  if (parse_params(argc, argv, &options) == -1) {
+    /* error is printed by parse_params() */
+    usage(stderr, argv[0], EXIT_FAILURE);
   }
 
-  if ((write_fd = fdopen(sock, "w")) == NULL) {
-    warn("fdopen w");
-    close(sock);
+  if (cache.dir != NULL && cache_open(cache.dir) == -1) {
+    /* error is printed by cache_open() */
     return EXIT_FAILURE;
   }
+  v("server: %s, port: %s, user: %s, message: %s, img_url: %s, window: %ld, batch: %ld, status_only: %d\n",
+    options.server, options.port, options.user, options.message, options.img_url, options.window, options.batch,
+    options.status_only);
 
-  if (request(write_fd, sock, user, message, img_url) == -1) {
-    /* error is printed by request() */
-    fclose(write_fd); /* also closes sock */
+  /* a server closing the connection is reported by the failing write */
+  (void)signal(SIGPIPE, SIG_IGN);
+
+  version = options.version;
+
+  if (open_session(options.server, options.port, &version, &read_fd, &write_fd) == -1) {
+    /* error is printed by open_session() */
     return EXIT_FAILURE;
   }
 
-  if ((read_fd = fdopen(sock, "r")) == NULL) {
-    warn("fdopen r");
-    fclose(write_fd);
-    return EXIT_FAILURE;
+  if (version == 0) {
+    /* the server answered right away, e.g. because it is busy */
+    status = response(read_fd, 1, 1);
+  } else if (options.last != -1 || options.after != -1 || options.since != -1 || options.follow) {
+    status = fetch(read_fd, write_fd, version, &options);
+  } else if (strcmp(options.message, "-") == 0) {
+    status = post_lines(&options, version, &read_fd, &write_fd);
+  } else {
+    status = post(read_fd, write_fd, version, &options, options.message);
   }
 
-  if ((status = response(read_fd)) == -1) {
-    /* error is printed by response() */
-    fclose(write_fd);
-    fclose(read_fd);
+  close_session(read_fd, write_fd);
+
+  if (status == -1) {
+    /* error is printed by post() and response() */
     return EXIT_FAILURE;
   }
 
-  fclose(write_fd);
-  fclose(read_fd);
-
   v("Terminating normally with status %d\n", status);
   return status;
 }
@@ -94,10 +180,191 @@ int main(int argc, const char *argv[]) {
  * @param code the exit code
  */
 static void usage(FILE *stream, const char *cmd, int code) {
-  (void)fprintf(stream, "Usage: %s -s server -p port -u user [-i image URL] -m message [-v] [-h]\n", cmd);
+  (void)fprintf(stream,
+                "Usage: %s -s server -p port -u user [-i image URL] -m message [-V version] [-w window] "
+                "[-b batch] [-n] [-c cache dir] [-v] [-h]\n"
+                "       %s -s server -p port [-f count] [-a cursor] [-S time] [-F] [-v] [-h]\n",
+                cmd, cmd);
+  (void)fprintf(stream, "       with -V 2, protocol version 2 is used (default 1), which the server\n"
+                        "       has to support; -w, -b, -n and -c only take effect with it, and\n"
+                        "       fetching always uses it;\n"
+                        "       with -m -, every line of stdin is posted as a message of its own,\n"
+                        "       up to window (default %d) of them before the first response;\n"
+                        "       with -b, up to batch of these messages are posted in a single request;\n"
+                        "       with -n, the server is asked to send the status only, without files;\n"
+                        "       with -c, files the server marks as unchanging are kept in the cache dir\n"
+                        "       and linked from there instead of being received again;\n"
+                        "       with -f, the newest count entries of the bulletin board are printed,\n"
+                        "       with -a, the entries after the cursor, with -S, the entries posted\n"
+                        "       since time (seconds since the epoch), and the cursor to continue\n"
+                        "       with is printed to stderr; with -F, the entries appended later are\n"
+                        "       printed as they come\n",
+                DEFAULT_WINDOW);
   exit(code);
 }
 
+/**
+ * @brief parses the command line arguments
+ *
+ * @param argc the number of arguments
+ * @param argv the arguments
+ * @param options where to save the parsed options
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int parse_params(int argc, char *argv[], options_t *options) {
+  int opt;
+  char *notconv;
+
+  struct option long_options[] = {
+      {"server", 1, NULL, 's'},
+      {"port", 1, NULL, 'p'},
+      {"user", 1, NULL, 'u'},
+      {"image", 1, NULL, 'i'},
+      {"message", 1, NULL, 'm'},
+      {"protocol", 1, NULL, 'V'},
+      {"window", 1, NULL, 'w'},
+      {"batch", 1, NULL, 'b'},
+      {"fetch", 1, NULL, 'f'},
+      {"after", 1, NULL, 'a'},
+      {"since", 1, NULL, 'S'},
+      {"follow", 0, NULL, 'F'},
+      {"status-only", 0, NULL, 'n'},
+      {"cache", 1, NULL, 'c'},
+      {"verbose", 0, NULL, 'v'},
+      {"help", 0, NULL, 'h'},
+      {0, 0, 0, 0}
+  };
+
+  while ((opt = getopt_long(argc, argv, "s:p:u:i:m:V:w:b:f:a:S:Fnc:vh", long_options, NULL)) != -1) {
+    switch (opt) {
+
+    case 's':
+      options->server = optarg;
+      break;
+
+    case 'p':
+      options->port = optarg;
+      break;
+
+    case 'u':
+      options->user = optarg;
+      break;
+
+    case 'i':
+      options->img_url = optarg;
+      break;
+
+    case 'm':
+      options->message = optarg;
+      break;
+
+    case 'V':
+      errno = 0;
+      options->version = (int)strtol(optarg, &notconv, 10);
+      if (errno != 0 || *notconv != '\0' || options->version < 1 || options->version > PROTOCOL_VERSION) {
+        warnx("Invalid protocol version, it has to be between 1 and %d", PROTOCOL_VERSION);
+        return -1;
+      }
+      break;
+
+    case 'w':
+      errno = 0;
+      options->window = strtol(optarg, &notconv, 10);
+      if (errno != 0 || *notconv != '\0' || options->window < 1 || options->window > MAX_WINDOW) {
+        warnx("Invalid window, it has to be between 1 and %d", MAX_WINDOW);
+        return -1;
+      }
+      break;
+
+    case 'b':
+      errno = 0;
+      options->batch = strtol(optarg, &notconv, 10);
+      if (errno != 0 || *notconv != '\0' || options->batch < 1 || options->batch > MAX_BATCH) {
+        warnx("Invalid batch, it has to be between 1 and %d", MAX_BATCH);
+        return -1;
+      }
+      break;
+
+    case 'f':
+      errno = 0;
+      options->last = strtol(optarg, &notconv, 10);
+      if (errno != 0 || *notconv != '\0' || options->last < 1) {
+        warnx("Invalid count of entries to fetch");
+        return -1;
+      }
+      break;
+
+    case 'a':
+      errno = 0;
+      options->after = strtol(optarg, &notconv, 10);
+      if (errno != 0 || *notconv != '\0' || options->after < 0) {
+        warnx("Invalid cursor");
+        return -1;
+      }
+      break;
+
+    case 'S':
+      errno = 0;
+      options->since = strtol(optarg, &notconv, 10);
+      if (errno != 0 || *notconv != '\0' || options->since < 0) {
+        warnx("Invalid time");
+        return -1;
+      }
+      break;
+
+    case 'F':
+      options->follow = 1;
+      break;
+
+    case 'n':
+      options->status_only = 1;
+      break;
+
+    case 'c':
+      cache.dir = optarg;
+      break;
+
+    case 'v':
+      verbose = 1;
+      break;
+
+    case 'h':
+      usage(stdout, argv[0], EXIT_SUCCESS);
+      break;
+
+    default:
+      /* error is printed by getopt_long() */
+      return -1;
+    }
+  }
+
+  if (optind < argc) {
+    warnx("Non-option arguments present");
+    return -1;
+  }
+
+  if (options->server == NULL || options->port == NULL ||
+      ((options->user == NULL || options->message == NULL) && options->last == -1 && options->after == -1 &&
+       options->since == -1 && !options->follow)) {
+    warnx("Arguments missing");
+    return -1;
+  }
+
+  /* the version is never guessed from the server, fetching exists with version 2 only */
+  if (options->last != -1 || options->after != -1 || options->since != -1 || options->follow) {
+    if (options->version == 1) {
+      warnx("Fetching needs protocol version 2");
+      return -1;
+    }
+    options->version = PROTOCOL_VERSION;
+  } else if (options->version == 0) {
+    options->version = 1;
+  }
+
+  return 0;
+}
+
 /**
  * @brief initiates a connection to the server
  *
@@ -158,185 +425,1446 @@ static int connection(const char *server, const char *port) {
 }
 
 /**
- * @brief sends the request to the server
+ * @brief connects to the server and negotiates the protocol version
  *
- * @param write_fd the stream descriptor
- * @param sock the socket identifier
- * @param user the user string
- * @param message the message string
- * @param img_url the img_url string
+ * @param server the server address
+ * @param port the server port
+ * @param version the protocol version, only negotiated if it is 2; set to 0
+ *                if the server answered right away with a response
+ * @param read_fd where to store the reading stream
+ * @param write_fd where to store the writing stream
  *
  * @returns 0 if everything went well or -1 in case of error
  */
-static int request(FILE *write_fd, int sock, const char *user, const char *message, const char *img_url) {
-
-  /* img_url is optional */
-  img_url = (img_url != NULL) ? img_url : "";
+static int open_session(const char *server, const char *port, int *version, FILE **read_fd, FILE **write_fd) {
+  int sock;
 
-  /* prefixes */
-  const char *user_p = "user=";
-  const char *message_p = "\n";
-  const char *img_url_p = (img_url[0] != '\0') ? "\nimg=" : "";
+  if ((sock = connection(server, port)) == -1) {
+    /* error is printed by connection() */
+    return -1;
+  }
 
-  size_t length = strlen(user_p) + strlen(img_url_p) + strlen(message_p) +
-                  strlen(user) + strlen(img_url) + strlen(message) + 1;
+  if ((*read_fd = fdopen(sock, "r")) == NULL) {
+    warn("fdopen r");
+    close(sock);
+    return -1;
+  }
 
-  char *request = calloc(length, sizeof(char));
+  if (*version == PROTOCOL_VERSION) {
+    if ((*version = negotiate(*read_fd, sock)) == -1) {
+      /* error is printed by negotiate() */
+      fclose(*read_fd); /* also closes sock */
+      return -1;
+    }
+  }
 
-  if (request == NULL) {
-    warn("calloc");
+  if ((*write_fd = fdopen(sock, "w")) == NULL) {
+    warn("fdopen w");
+    fclose(*read_fd);
     return -1;
   }
 
-  snprintf(request, length, "%s%s%s%s%s%s", user_p, user, img_url_p, img_url, message_p, message);
-  v("Request:\n%s\n", request);
+  return 0;
+}
 
-  if (fprintf(write_fd, "%s", request) < 0) {
-    warn("fprintf");
-    free(request);
+/**
+ * @brief closes the connection to the server
+ *
+ * @param read_fd the reading stream
+ * @param write_fd the writing stream
+ */
+static void close_session(FILE *read_fd, FILE *write_fd) {
+  if (write_fd != NULL) {
+    fclose(write_fd);
+  }
+  if (read_fd != NULL) {
+    fclose(read_fd); /* the socket is already closed */
+  }
+}
+
+/**
+ * @brief negotiates the protocol version with the server
+ *
+ * The client announces version 2 and waits for the server to confirm it.
+ * Version 2 is only used when the user asks for it (or fetches), since a
+ * server which only knows version 1 takes the announcement for the start
+ * of a request and does not answer at all; such a server gives up on the
+ * connection after its read timeout.
+ *
+ * @param read_fd the stream descriptor, nothing must have been read yet
+ * @param sock the socket identifier
+ *
+ * @returns 2 if the server speaks version 2, 0 if it answered with a
+ *          response right away or -1 in case of error
+ */
+static int negotiate(FILE *read_fd, int sock) {
+  static const char hello[] = "version=2\n";
+  char *line = NULL;
+  size_t len = 0;
+  long version = -1;
+  int c;
+
+  if (send(sock, hello, strlen(hello), MSG_NOSIGNAL) == -1) {
+    warn("send");
     return -1;
   }
 
-  if (fflush(write_fd) != 0) {
-    warn("fflush");
-    free(request);
+  if ((c = getc(read_fd)) == EOF) {
+    if (ferror(read_fd)) {
+      warn("getc");
+    } else {
+      warnx("Got an empty response");
+    }
     return -1;
   }
+  ungetc(c, read_fd);
 
-  if (shutdown(sock, SHUT_WR) == -1) {
-    warn("shutdown");
-    free(request);
+  if (c != 'v') {
+    return 0; /* a response without negotiation */
+  }
+
+  if (getline(&line, &len, read_fd) == -1 || parse_long(line, "version", &version) == -1 ||
+      version != PROTOCOL_VERSION) {
+    warnx("Could not negotiate the protocol version");
+    free(line);
     return -1;
   }
 
-  free(request);
+  v("Version: %ld\n", version);
+  free(line);
 
-  return 0;
+  return PROTOCOL_VERSION;
 }
 
 /**
- * @brief receives the response
+ * @brief fetches entries of the bulletin board and prints them
  *
- * @param read_fd the stream descriptor
+ * The request is "fetch=<length>\n" followed by the fields "last" with
+ * the number of entries, "after" with the cursor and "since" with the
+ * time. When following,
+ * "subscribe=<length>\n" requests with the same fields and the cursor
+ * of the last response follow, the server answers them once entries
+ * are appended (or without entries after a while).
+ *
+ * @param read_fd the reading stream
+ * @param write_fd the writing stream
+ * @param version the protocol version
+ * @param options the options with the number of entries and the cursor
  *
  * @returns the status from the server or -1 in case of error
  */
-static int response(FILE *read_fd) {
-  parsing stage = GET_STATUS;
-  char *line = NULL;
-  char file_name[NAME_MAX];
-  long status = -1;
-  long file_len = 0;
-  long counter = 0;
-  ssize_t read = -1;
+static int fetch(FILE *read_fd, FILE *write_fd, int version, const options_t *options) {
+  FILE *fields;
+  char *buf = NULL;
   size_t len = 0;
-  FILE *fp = NULL;
+  char number[32];
+  const char *type = "fetch";
+  long last = options->last;
+  long after = options->after;
+  long since = options->since;
+  int result = 0;
+
+  if (version < 2) {
+    warnx("The server cannot be fetched from");
+    return -1;
+  }
 
-  errno = 0;
-  while ((read = getline(&line, &len, read_fd)) != -1) {
+  /* following from the current end of the bulletin board */
+  if (last == -1 && after == -1 && since == -1) {
+    last = 0;
+  }
 
-    switch (stage) {
+  do {
+    if ((fields = open_memstream(&buf, &len)) == NULL) {
+      warn("open_memstream");
+      return -1;
+    }
 
-    case GET_STATUS: {
-      if (parse_long(line, "status", &status) == -1) {
-        break; /* quit the switch to "Could not process the response" */
-      }
+    if (last != -1) {
+      (void)snprintf(number, sizeof(number), "%ld", last);
+      result = write_field(fields, "last", number);
+    }
+    if (result == 0 && after != -1) {
+      (void)snprintf(number, sizeof(number), "%ld", after);
+      result = write_field(fields, "after", number);
+    }
+    if (result == 0 && since != -1) {
+      (void)snprintf(number, sizeof(number), "%ld", since);
+      result = write_field(fields, "since", number);
+    }
 
-      v("Status: %ld\n", status);
-      stage++;
-      continue; /* continue the while loop */
+    if (fclose(fields) == EOF) {
+      warn("fclose");
+      result = -1;
     }
 
-    case GET_FILE: {
-      if (parse_string(line, "file", file_name, NAME_MAX) == -1) {
-        break;
-      }
+    if (result == 0 &&
+        (fprintf(write_fd, "%s=%zu\n", type, len) < 0 || fwrite(buf, sizeof(char), len, write_fd) != len)) {
+      warn("fprintf");
+      result = -1;
+    }
 
-      v("File: %s\n", file_name);
-      stage++;
-      continue;
+    free(buf);
+    buf = NULL;
+
+    if (result == 0) {
+      (void)collect_response(read_fd, write_fd, version, 1, &result);
     }
 
-    case GET_LEN: {
-      if (parse_long(line, "len", &file_len) == -1) {
-        break;
-      }
+    type = "subscribe";
+    after = cursor;
+    since = -1;
+    if (last == 0) {
+      last = -1;
+    }
+  } while (result == 0 && options->follow && cursor != -1);
 
-      if ((fp = fopen(file_name, "w+")) == NULL) {
-        break;
-      }
+  return result;
+}
 
-      v("Len: %ld\n", file_len);
-      stage++;
-      continue;
+/**
+ * @brief posts a message and receives the response
+ *
+ * @param read_fd the reading stream
+ * @param write_fd the writing stream
+ * @param version the protocol version
+ * @param options the options with the user and image
+ * @param message the message string
+ *
+ * @returns the status from the server or -1 in case of error
+ */
+static int post(FILE *read_fd, FILE *write_fd, int version, const options_t *options, const char *message) {
+  int result = 0;
+
+  if (request(write_fd, version, options, message) == -1) {
+    /* error is printed by request() */
+    return -1;
+  }
+
+  (void)collect_response(read_fd, write_fd, version, 1, &result);
+
+  return result;
+}
+
+/**
+ * @brief posts every line of stdin as a message of its own
+ *
+ * With version 2 all messages are posted over the same connection, up to
+ * a window of requests ahead of their responses, which the server answers
+ * in order. Everything in flight fits into the socket buffers, so the
+ * client cannot block writing while the server blocks writing responses
+ * nobody reads. With a batch size, the messages are collected into batch
+ * requests, which the server posts under a single lock of the bulletin
+ * board. A version 1 connection carries a single message.
+ *
+ * @param options the options with the server, user, image, window and batch size
+ * @param version the protocol version
+ * @param read_fd the reading stream, replaced when reconnecting
+ * @param write_fd the writing stream, replaced when reconnecting
+ *
+ * @returns 0 if all messages were posted, the status of the first failed post
+ *          or -1 in case of error
+ */
+static int post_lines(const options_t *options, int version, FILE **read_fd, FILE **write_fd) {
+  char *line = NULL;
+  size_t len = 0;
+  ssize_t cnt;
+  batch_t batch = {NULL, 0, 0, 0};
+  long first_lines[MAX_WINDOW]; /* of the requests in flight */
+  long lines = 0;
+  long posts = 0;
+  long in_flight = 0;
+  long first;
+  int batching = (version >= 2 && options->batch > 1);
+  int added = 0;
+  int result = 0;
+
+  while (result != -1) {
+    if ((cnt = getline(&line, &len, stdin)) != -1) {
+      if (cnt > 0 && line[cnt - 1] == '\n') {
+        line[cnt - 1] = '\0';
+      }
+      lines++;
+    } else if (!batching || batch.records == 0) {
+      break;
     }
 
-    case GET_DATA: {
-      counter += read;
+    if (version == 1 && posts > 0) {
+      close_session(*read_fd, *write_fd);
+      *read_fd = *write_fd = NULL;
 
-      if (counter > file_len) {
-        warnx("File bigger than expected");
+      if (open_session(options->server, options->port, &version, read_fd, write_fd) == -1) {
+        /* error is printed by open_session() */
+        result = -1;
         break;
       }
+    }
 
-      if (fwrite(line, sizeof(char), (size_t)read, fp) != (size_t)read) {
-        warn("fwrite");
+    if (batching) {
+      /* a record which does not fit goes into the next batch */
+      if (cnt != -1 && (added = add_record(&batch, options, line, lines)) == -1) {
+        /* error is printed by add_record() */
+        result = -1;
         break;
       }
+      if (cnt != -1 && added == 1 && batch.records < options->batch) {
+        continue;
+      }
 
-      v("Written: %ld of %ld\n", counter, file_len);
-
-      if (counter == file_len) {
-        stage = GET_FILE;
-        counter = 0;
-        file_len = 0;
-
-        if (fclose(fp) == EOF) {
-          warn("fclose");
-          fp = NULL;
-          break;
-        }
-        fp = NULL;
+      first = batch.first;
+      if (request_batch(*write_fd, &batch) == -1 ||
+          (cnt != -1 && added == 0 && add_record(&batch, options, line, lines) == -1)) {
+        /* error is printed by request_batch() and add_record() */
+        result = -1;
+        break;
+      }
+    } else {
+      first = lines;
+      if (request(*write_fd, version, options, line) == -1) {
+        /* error is printed by request() */
+        result = -1;
+        break;
       }
-      continue;
     }
+    first_lines[posts % MAX_WINDOW] = first;
+    posts++;
+    in_flight++;
 
-    default:
-      break;
+    if (version == 1 || in_flight == options->window) {
+      if (collect_response(*read_fd, *write_fd, version, first_lines[(posts - in_flight) % MAX_WINDOW], &result) ==
+          -1) {
+        break;
+      }
+      in_flight--;
     }
+  }
 
-    warnx("Could not process the response");
-    status = -1;
-    break;
+  while (result != -1 && in_flight > 0 &&
+         collect_response(*read_fd, *write_fd, version, first_lines[(posts - in_flight) % MAX_WINDOW], &result) == 0) {
+    in_flight--;
   }
 
-  if (read == -1) {
-    if (errno != 0) {
-      warn("getline");
-      status = -1;
-    }
-    if (counter < file_len) {
-      warnx("Response interrupted");
-      status = -1;
-    }
-    if (stage == GET_STATUS) {
-      warnx("Got an empty response");
-      status = -1;
-    }
+  if (ferror(stdin)) {
+    warn("getline");
+    result = -1;
   }
 
-  if (fp != NULL) {
-    if (fclose(fp) == EOF) {
-      warn("fclose");
-      status = -1;
-    }
+  free(line);
+  free(batch.data);
+
+  v("Posted %ld messages in %ld requests\n", lines, posts);
+  return result;
+}
+
+/**
+ * @brief receives the response to the oldest request in flight
+ *
+ * The requests written so far are flushed first, the server cannot answer
+ * them otherwise.
+ *
+ * @param read_fd the reading stream
+ * @param write_fd the writing stream
+ * @param version the protocol version
+ * @param first_line the line of stdin with the first message of the request
+ * @param result set to the status if it is the first failed one, to -1 in case of error
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int collect_response(FILE *read_fd, FILE *write_fd, int version, long first_line, int *result) {
+  int status;
+
+  if (fflush(write_fd) != 0) {
+    warn("fflush");
+    *result = -1;
+    return -1;
   }
 
-  if (line != NULL) {
-    free(line);
+  if ((status = response(read_fd, version, first_line)) == -1) {
+    /* error is printed by response() */
+    *result = -1;
+    return -1;
   }
 
-  return (int)status;
+  if (status != 0 && *result == 0) {
+    *result = status;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief sends the request to the server
+ *
+ * A version 1 request ends with the shutdown of the sending direction.
+ *
+ * @param write_fd the stream descriptor
+ * @param version the protocol version
+ * @param options the options with the user and image
+ * @param message the message string
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int request(FILE *write_fd, int version, const options_t *options, const char *message) {
+  const char *user = options->user;
+  const char *img_url = options->img_url;
+
+  if (version >= 2) {
+    return request_framed(write_fd, options, message);
+  }
+
+  /* img_url is optional */
+  img_url = (img_url != NULL) ? img_url : "";
+
+  /* prefixes */
+  const char *user_p = "user=";
+  const char *message_p = "\n";
+  const char *img_url_p = (img_url[0] != '\0') ? "\nimg=" : "";
+
+  size_t length = strlen(user_p) + strlen(img_url_p) + strlen(message_p) +
+                  strlen(user) + strlen(img_url) + strlen(message) + 1;
+
+  char *request = calloc(length, sizeof(char));
+
+  if (request == NULL) {
+    warn("calloc");
+    return -1;
+  }
+
+  snprintf(request, length, "%s%s%s%s%s%s", user_p, user, img_url_p, img_url, message_p, message);
+  v("Request:\n%s\n", request);
+
+  if (fprintf(write_fd, "%s", request) < 0) {
+    warn("fprintf");
+    free(request);
+    return -1;
+  }
+
+  if (fflush(write_fd) != 0) {
+    warn("fflush");
+    free(request);
+    return -1;
+  }
+
+  if (shutdown(fileno(write_fd), SHUT_WR) == -1) {
+    warn("shutdown");
+    free(request);
+    return -1;
+  }
+
+  free(request);
+
+  return 0;
+}
+
+/**
+ * @brief sends a version 2 request to the server
+ *
+ * The request is "request=<length>\n" followed by the fields, each as
+ * "<key>=<length>\n<value>", so it can be parsed without the shutdown of
+ * the sending direction. It is not flushed, see collect_response().
+ *
+ * @param write_fd the stream descriptor
+ * @param options the options with the user, image and response mode
+ * @param message the message string
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int request_framed(FILE *write_fd, const options_t *options, const char *message) {
+  char *buf = NULL;
+  size_t len = 0;
+  int status = 0;
+
+  if (build_fields(options, message, 0, &buf, &len) == -1) {
+    /* error is printed by build_fields() */
+    return -1;
+  }
+
+  v("Request of %zu bytes\n", len);
+
+  if (fprintf(write_fd, "request=%zu\n", len) < 0 || fwrite(buf, sizeof(char), len, write_fd) != len) {
+    warn("fprintf");
+    status = -1;
+  }
+
+  free(buf);
+
+  return status;
+}
+
+/**
+ * @brief adds a message to a batch request
+ *
+ * Each record is "record=<length>\n" followed by the fields of the
+ * message. The first one is preceded by the field asking for the
+ * durability of the posts. A batch has to fit into BATCH_LIMIT bytes,
+ * unless it is a single record the server rejects anyway.
+ *
+ * @param batch the batch
+ * @param options the options with the user and image
+ * @param message the message string
+ * @param line the line of stdin with the message
+ *
+ * @returns 1 if the message was added, 0 if it does not fit into the batch
+ *          or -1 in case of error
+ */
+static int add_record(batch_t *batch, const options_t *options, const char *message, long line) {
+  char header[sizeof(BATCH_DURABILITY) + 32] = "";
+  char *buf = NULL;
+  char *data;
+  size_t len = 0;
+  size_t header_len;
+
+  if (build_fields(options, message, 1, &buf, &len) == -1) {
+    /* error is printed by build_fields() */
+    return -1;
+  }
+
+  if (batch->records == 0) {
+    strcpy(header, BATCH_DURABILITY);
+  }
+  header_len = strlen(header);
+  header_len += (size_t)snprintf(header + header_len, sizeof(header) - header_len, "record=%zu\n", len);
+
+  if (batch->records > 0 && batch->len + header_len + len > BATCH_LIMIT) {
+    free(buf);
+    return 0;
+  }
+
+  if ((data = realloc(batch->data, batch->len + header_len + len)) == NULL) {
+    warn("realloc");
+    free(buf);
+    return -1;
+  }
+
+  memcpy(data + batch->len, header, header_len);
+  memcpy(data + batch->len + header_len, buf, len);
+  batch->data = data;
+  batch->len += header_len + len;
+  if (batch->records++ == 0) {
+    batch->first = line;
+  }
+
+  free(buf);
+  return 1;
+}
+
+/**
+ * @brief sends a batch request to the server and empties the batch
+ *
+ * The request is "batch=<length>\n" followed by the records. It is not
+ * flushed, see collect_response().
+ *
+ * @param write_fd the stream descriptor
+ * @param batch the batch
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int request_batch(FILE *write_fd, batch_t *batch) {
+  v("Batch of %ld messages, %zu bytes\n", batch->records, batch->len);
+
+  if (fprintf(write_fd, "batch=%zu\n", batch->len) < 0 ||
+      fwrite(batch->data, sizeof(char), batch->len, write_fd) != batch->len) {
+    warn("fprintf");
+    return -1;
+  }
+
+  batch->len = 0;
+  batch->records = 0;
+
+  return 0;
+}
+
+/**
+ * @brief collects the fields of a version 2 request
+ *
+ * @param options the options with the user, image and response mode
+ * @param message the message string
+ * @param record nonzero for a record of a batch, which has no fields about the response
+ * @param buf set to the allocated fields
+ * @param len set to the length of the fields
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int build_fields(const options_t *options, const char *message, int record, char **buf, size_t *len) {
+  FILE *fields;
+  char cached[MAX_CACHED * (HASH_LEN + 1) + 1] = "";
+  int status = 0;
+
+  *buf = NULL;
+  *len = 0;
+
+  /* the fields are collected first, their length precedes them */
+  if ((fields = open_memstream(buf, len)) == NULL) {
+    warn("open_memstream");
+    return -1;
+  }
+
+  if (write_field(fields, "user", options->user) == -1 ||
+      (options->img_url != NULL && options->img_url[0] != '\0' &&
+       write_field(fields, "img", options->img_url) == -1) ||
+      write_field(fields, "message", message) == -1) {
+    status = -1;
+  }
+
+  if (status == 0 && !record &&
+      ((options->status_only && write_field(fields, "reply", "status") == -1) ||
+       (!options->status_only && write_field(fields, "manifest", "yes") == -1) ||
+       write_field(fields, "encoding", "deflate") == -1 || write_field(fields, "durability", "yes") == -1)) {
+    status = -1;
+  }
+
+  /* an empty list still tells the server to mark the files it may refer to */
+  if (status == 0 && !record && cache.dir != NULL) {
+    for (size_t i = 0; i < cache.count; i++) {
+      strcat(cached, (i > 0) ? " " : "");
+      strcat(cached, cache.hashes[i]);
+    }
+    if (write_field(fields, "cached", cached) == -1) {
+      status = -1;
+    }
+  }
+
+  if (fclose(fields) == EOF) {
+    warn("fclose");
+    status = -1;
+  }
+
+  if (status == -1) {
+    free(*buf);
+    *buf = NULL;
+  }
+
+  return status;
+}
+
+/**
+ * @brief writes a field of a version 2 request
+ *
+ * @param fields the stream the field is written to
+ * @param key the name of the field
+ * @param value the value of the field
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int write_field(FILE *fields, const char *key, const char *value) {
+  if (fprintf(fields, "%s=%zu\n%s", key, strlen(value), value) < 0) {
+    warn("fprintf");
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief receives the response
+ *
+ * A version 2 response announces the number of files after the status,
+ * a version 1 response ends with the connection.
+ *
+ * @param read_fd the stream descriptor
+ * @param version the protocol version
+ * @param first_line the line of stdin with the first message of the request
+ *
+ * @returns the status from the server or -1 in case of error
+ */
+static int response(FILE *read_fd, int version, long first_line) {
+  char *line = NULL;
+  size_t len = 0;
+  long status = -1;
+  long files = -1; /* unknown for version 1 */
+  int pending = 0; /* the line of the first file is read already */
+
+  errno = 0;
+  if (getline(&line, &len, read_fd) == -1) {
+    if (errno != 0) {
+      warn("getline");
+    } else {
+      warnx("Got an empty response");
+    }
+    free(line);
+    return -1;
+  }
+
+  if (parse_long(line, "status", &status) == -1) {
+    warnx("Could not process the response");
+    free(line);
+    return -1;
+  }
+  v("Status: %ld\n", status);
+
+  if (version >= 2) {
+    if (getline(&line, &len, read_fd) == -1) {
+      warnx("Could not process the response");
+      free(line);
+      return -1;
+    }
+
+    /* the response to a post tells how durable it is */
+    if (strncmp(line, "durability=", strlen("durability=")) == 0) {
+      v("Durability: %s", line + strlen("durability="));
+      if (getline(&line, &len, read_fd) == -1) {
+        warnx("Could not process the response");
+        free(line);
+        return -1;
+      }
+    }
+
+    /* a status-only response carries the error message itself */
+    if (strncmp(line, "error=", strlen("error=")) == 0) {
+      if (receive_error(read_fd, line) == -1 || getline(&line, &len, read_fd) == -1) {
+        warnx("Could not process the response");
+        free(line);
+        return -1;
+      }
+    }
+
+    /* the response to a fetch carries the entries */
+    if (strncmp(line, "cursor=", strlen("cursor=")) == 0) {
+      if (receive_entries(read_fd, line) == -1 || getline(&line, &len, read_fd) == -1) {
+        warnx("Could not process the response");
+        free(line);
+        return -1;
+      }
+    }
+
+    /* so does the response to a batch with the status of every message */
+    if (strncmp(line, "results=", strlen("results=")) == 0) {
+      if (receive_results(read_fd, line, first_line) == -1 || getline(&line, &len, read_fd) == -1) {
+        warnx("Could not process the response");
+        free(line);
+        return -1;
+      }
+    }
+
+    if (parse_long(line, "files", &files) == -1 || files < 0) {
+      warnx("Could not process the response");
+      free(line);
+      return -1;
+    }
+    v("Files: %ld\n", files);
+
+    /* the manifest lists the files ahead of them */
+    if (files > 0) {
+      if (getline(&line, &len, read_fd) == -1) {
+        warnx("Could not process the response");
+        free(line);
+        return -1;
+      }
+
+      pending = (strncmp(line, "manifest=", strlen("manifest=")) != 0);
+      if (!pending && receive_manifest(read_fd, line) == -1) {
+        warnx("Could not process the response");
+        close_manifest();
+        free(line);
+        return -1;
+      }
+    }
+  }
+
+  while (files != 0) {
+    errno = 0;
+    if (!pending && getline(&line, &len, read_fd) == -1) {
+      if (errno != 0) {
+        warn("getline");
+        status = -1;
+      } else if (files > 0) {
+        warnx("Response interrupted");
+        status = -1;
+      }
+      break; /* a version 1 response is complete */
+    }
+
+    pending = 0;
+
+    if (receive_file(read_fd, &line, &len) == -1) {
+      /* error is printed by receive_file() */
+      status = -1;
+      break;
+    }
+
+    if (files > 0) {
+      files--;
+    }
+  }
+
+  close_manifest();
+  free(line);
+
+  return (int)status;
+}
+
+/**
+ * @brief receives the error message of a status-only response and prints it
+ *
+ * @param read_fd the stream descriptor
+ * @param line the line with the length of the message
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int receive_error(FILE *read_fd, char *line) {
+  char *message;
+  long message_len;
+
+  if (parse_long(line, "error", &message_len) == -1 || message_len < 0) {
+    return -1;
+  }
+
+  if ((message = malloc((size_t)message_len + 1)) == NULL) {
+    warn("malloc");
+    return -1;
+  }
+
+  if (fread(message, sizeof(char), (size_t)message_len, read_fd) != (size_t)message_len) {
+    free(message);
+    return -1;
+  }
+
+  /* the message usually ends with a newline */
+  while (message_len > 0 && message[message_len - 1] == '\n') {
+    message_len--;
+  }
+  message[message_len] = '\0';
+
+  warnx("Server: %s", message);
+  free(message);
+
+  return 0;
+}
+
+/**
+ * @brief receives the entries of a fetch, prints them to stdout and the cursor to stderr
+ *
+ * @param read_fd the stream descriptor
+ * @param line the line with the cursor, reused for the length
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int receive_entries(FILE *read_fd, char *line) {
+  char buf[BUFSIZ];
+  char *entries_line = NULL;
+  size_t entries_line_len = 0;
+  long entries_len;
+  long counter = 0;
+  size_t chunk;
+  int status = 0;
+
+  if (parse_long(line, "cursor", &cursor) == -1 || cursor < 0 ||
+      getline(&entries_line, &entries_line_len, read_fd) == -1 ||
+      parse_long(entries_line, "entries", &entries_len) == -1 || entries_len < 0) {
+    free(entries_line);
+    return -1;
+  }
+  free(entries_line);
+  v("Entries: %ld bytes\n", entries_len);
+
+  while (counter < entries_len) {
+    chunk = ((size_t)(entries_len - counter) < sizeof(buf)) ? (size_t)(entries_len - counter) : sizeof(buf);
+
+    if (fread(buf, sizeof(char), chunk, read_fd) != chunk) {
+      warnx("Response interrupted");
+      return -1;
+    }
+
+    if (fwrite(buf, sizeof(char), chunk, stdout) != chunk) {
+      warn("fwrite");
+      status = -1;
+    }
+
+    counter += (long)chunk;
+  }
+
+  if (fflush(stdout) != 0) {
+    warn("fflush");
+    status = -1;
+  }
+
+  (void)fprintf(stderr, "cursor=%ld\n", cursor);
+
+  return status;
+}
+
+/**
+ * @brief receives the manifest of a response and opens the files listed in it
+ *
+ * The manifest has a line "<length> <name>\n" for every file whose
+ * contents follow. The files are created and their space is allocated
+ * up front, where the file system supports it.
+ *
+ * @param read_fd the stream descriptor
+ * @param line the line with the length of the manifest
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int receive_manifest(FILE *read_fd, char *line) {
+  char *entries;
+  char *p;
+  char *end;
+  char *name;
+  long entries_len;
+  long file_len;
+  long total = 0;
+  FILE *fp;
+  int status = 0;
+
+  if (parse_long(line, "manifest", &entries_len) == -1 || entries_len < 0) {
+    return -1;
+  }
+
+  if ((entries = malloc((size_t)entries_len + 1)) == NULL) {
+    warn("malloc");
+    return -1;
+  }
+
+  if (fread(entries, sizeof(char), (size_t)entries_len, read_fd) != (size_t)entries_len) {
+    free(entries);
+    return -1;
+  }
+  entries[entries_len] = '\0';
+
+  for (p = entries; *p != '\0' && status == 0; p = end + 1) {
+    errno = 0;
+    file_len = strtol(p, &name, 10);
+    if (errno != 0 || name == p || *name != ' ' || file_len < 0 || (end = strchr(++name, '\n')) == NULL ||
+        end == name || end - name >= NAME_MAX || manifest.count == MAX_MANIFEST) {
+      status = -1;
+      break;
+    }
+    *end = '\0';
+
+    if (unshare_file(name) == -1) {
+      /* error is printed by unshare_file() */
+      status = -1;
+    } else if ((fp = fopen(name, "w+")) == NULL) {
+      warn("fopen");
+      status = -1;
+    } else {
+      /* a file system without support just allocates while writing */
+      if (file_len > 0 && fallocate(fileno(fp), 0, 0, (off_t)file_len) == -1 && errno != EOPNOTSUPP) {
+        warn("fallocate %s", name);
+      }
+
+      (void)strcpy(manifest.names[manifest.count], name);
+      manifest.files[manifest.count++] = fp;
+      total += file_len;
+    }
+  }
+  v("Manifest: %zu files, %ld bytes\n", manifest.count, total);
+
+  free(entries);
+
+  return status;
+}
+
+/**
+ * @brief takes a file opened for the manifest
+ *
+ * @param file_name the name of the file
+ *
+ * @returns the open file or NULL if it is not listed in the manifest
+ */
+static FILE *manifest_file(const char *file_name) {
+  FILE *fp;
+
+  for (size_t i = 0; i < manifest.count; i++) {
+    if (manifest.files[i] != NULL && strcmp(manifest.names[i], file_name) == 0) {
+      fp = manifest.files[i];
+      manifest.files[i] = NULL;
+      return fp;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief closes the files of the manifest which were not received
+ */
+static void close_manifest(void) {
+  for (size_t i = 0; i < manifest.count; i++) {
+    if (manifest.files[i] != NULL) {
+      warnx("%s is listed in the manifest but was not received", manifest.names[i]);
+      (void)fclose(manifest.files[i]);
+    }
+  }
+  manifest.count = 0;
+}
+
+/**
+ * @brief receives the status of every message of a batch and reports the failed ones
+ *
+ * No status at all means the batch was rejected as a whole.
+ *
+ * @param read_fd the stream descriptor
+ * @param line the line with the length of the statuses
+ * @param first_line the line of stdin with the first message of the batch
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int receive_results(FILE *read_fd, char *line, long first_line) {
+  char *results;
+  char *p;
+  char *notconv;
+  long results_len;
+  long status;
+  long i;
+
+  if (parse_long(line, "results", &results_len) == -1 || results_len < 0) {
+    return -1;
+  }
+
+  if ((results = malloc((size_t)results_len + 1)) == NULL) {
+    warn("malloc");
+    return -1;
+  }
+
+  if (fread(results, sizeof(char), (size_t)results_len, read_fd) != (size_t)results_len) {
+    free(results);
+    return -1;
+  }
+  results[results_len] = '\0';
+
+  for (p = results, i = 0; *p != '\0'; p = notconv, i++) {
+    errno = 0;
+    status = strtol(p, &notconv, 10);
+    if (errno != 0 || notconv == p) {
+      free(results);
+      return -1;
+    }
+    if (status != 0) {
+      warnx("Line %ld: failed with status %ld", first_line + i, status);
+    }
+  }
+  v("Results: %ld\n", i);
+
+  free(results);
+
+  return 0;
+}
+
+/**
+ * @brief receives a file of the response
+ *
+ * With a cache, the server marks unchanging files with "hash=<hash>\n"
+ * before their length, they are stored in the cache once received. A file
+ * the client announced as cached comes as "cached=<hash>\n" only and is
+ * linked from the cache. A file sent as "encoding=deflate\n" is inflated
+ * on the way to the disk. A file listed in the manifest is open already.
+ *
+ * @param read_fd the stream descriptor
+ * @param line the line with the file name, reused for the length
+ * @param line_len the size of the line buffer
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int receive_file(FILE *read_fd, char **line, size_t *line_len) {
+  char file_name[NAME_MAX];
+  char hash[HASH_LEN + 2] = "";
+  char encoding[16] = "";
+  char computed[HASH_LEN + 1];
+  unsigned long long hash_value = 0xcbf29ce484222325ULL;
+  long file_len = 0;
+  FILE *fp = NULL;
+
+  if (parse_string(*line, "file", file_name, NAME_MAX) == -1) {
+    warnx("Could not process the response");
+    return -1;
+  }
+  v("File: %s\n", file_name);
+
+  if (getline(line, line_len, read_fd) == -1) {
+    warnx("Could not process the response");
+    return -1;
+  }
+
+  if (cache.dir != NULL && strncmp(*line, "cached=", strlen("cached=")) == 0) {
+    if (parse_string(*line, "cached", hash, sizeof(hash)) == -1 || strlen(hash) != HASH_LEN) {
+      warnx("Could not process the response");
+      return -1;
+    }
+    v("Cached: %s\n", hash);
+    return cache_fetch(hash, file_name);
+  }
+
+  if (cache.dir != NULL && strncmp(*line, "hash=", strlen("hash=")) == 0) {
+    if (parse_string(*line, "hash", hash, sizeof(hash)) == -1 || strlen(hash) != HASH_LEN ||
+        getline(line, line_len, read_fd) == -1) {
+      warnx("Could not process the response");
+      return -1;
+    }
+    v("Hash: %s\n", hash);
+  }
+
+  if (strncmp(*line, "encoding=", strlen("encoding=")) == 0) {
+    if (parse_string(*line, "encoding", encoding, sizeof(encoding)) == -1 || strcmp(encoding, "deflate") != 0 ||
+        getline(line, line_len, read_fd) == -1) {
+      warnx("Could not process the response");
+      return -1;
+    }
+    v("Encoding: %s\n", encoding);
+  }
+
+  if (parse_long(*line, "len", &file_len) == -1 || file_len < 0) {
+    warnx("Could not process the response");
+    return -1;
+  }
+  v("Len: %ld\n", file_len);
+
+  if ((fp = manifest_file(file_name)) == NULL) {
+    if (unshare_file(file_name) == -1) {
+      /* error is printed by unshare_file() */
+      return -1;
+    }
+
+    if ((fp = fopen(file_name, "w+")) == NULL) {
+      warn("fopen");
+      return -1;
+    }
+  }
+
+  if (receive_data(read_fd, fp, file_len, encoding[0] != '\0', &hash_value) == -1) {
+    /* error is printed by receive_data() */
+    fclose(fp);
+    return -1;
+  }
+
+  if (fclose(fp) == EOF) {
+    warn("fclose");
+    return -1;
+  }
+
+  if (hash[0] != '\0') {
+    (void)snprintf(computed, sizeof(computed), "%016llx", hash_value);
+    if (strcmp(computed, hash) == 0) {
+      cache_store(hash, file_name);
+    } else {
+      warnx("%s does not match its hash, not caching it", file_name);
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * @brief receives the contents of a file and writes them to disk
+ *
+ * @param read_fd the stream descriptor
+ * @param fp the file
+ * @param file_len the length of the contents as sent
+ * @param deflated whether the contents are a zlib stream to inflate
+ * @param hash_value the hash, continued with the contents written
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int receive_data(FILE *read_fd, FILE *fp, long file_len, int deflated, unsigned long long *hash_value) {
+  unsigned char buf[BUFSIZ];
+  long counter = 0;
+  size_t chunk;
+  z_stream strm;
+  int ended = 0;
+  int status = 0;
+
+  memset(&strm, 0, sizeof(strm));
+  if (deflated && inflateInit(&strm) != Z_OK) {
+    warnx("inflateInit(): %s", (strm.msg != NULL) ? strm.msg : "failed");
+    return -1;
+  }
+
+  while (counter < file_len) {
+    chunk = ((size_t)(file_len - counter) < sizeof(buf)) ? (size_t)(file_len - counter) : sizeof(buf);
+
+    if (fread(buf, sizeof(char), chunk, read_fd) != chunk) {
+      if (ferror(read_fd)) {
+        warn("fread");
+      } else {
+        warnx("Response interrupted");
+      }
+      status = -1;
+      break;
+    }
+
+    if (deflated) {
+      strm.next_in = buf;
+      strm.avail_in = (uInt)chunk;
+      if ((ended = inflate_chunk(&strm, fp, hash_value)) == -1) {
+        /* error is printed by inflate_chunk() */
+        status = -1;
+        break;
+      }
+    } else {
+      if (fwrite(buf, sizeof(char), chunk, fp) != chunk) {
+        warn("fwrite");
+        status = -1;
+        break;
+      }
+      *hash_value = hash_update(*hash_value, (const char *)buf, chunk);
+    }
+
+    counter += (long)chunk;
+    v("Written: %ld of %ld\n", counter, file_len);
+  }
+
+  if (deflated) {
+    if (status == 0 && ended != 1) {
+      warnx("Compressed data incomplete");
+      status = -1;
+    }
+    inflateEnd(&strm);
+  }
+
+  return status;
+}
+
+/**
+ * @brief inflates the received compressed data and writes it to disk
+ *
+ * @param strm the inflate stream, with the compressed data as input
+ * @param fp the file
+ * @param hash_value the hash, continued with the data written
+ *
+ * @returns 1 at the end of the compressed data, 0 if more is to come or -1 in
+ *          case of error
+ */
+static int inflate_chunk(z_stream *strm, FILE *fp, unsigned long long *hash_value) {
+  unsigned char out[BUFSIZ];
+  size_t have;
+  int ret;
+
+  do {
+    strm->next_out = out;
+    strm->avail_out = sizeof(out);
+
+    ret = inflate(strm, Z_NO_FLUSH);
+    if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+      warnx("inflate(): %s", (strm->msg != NULL) ? strm->msg : "failed");
+      return -1;
+    }
+
+    have = sizeof(out) - strm->avail_out;
+    if (fwrite(out, sizeof(char), have, fp) != have) {
+      warn("fwrite");
+      return -1;
+    }
+    *hash_value = hash_update(*hash_value, (const char *)out, have);
+
+    if (ret == Z_STREAM_END) {
+      if (strm->avail_in > 0) {
+        warnx("Trailing data after the compressed data");
+        return -1;
+      }
+      return 1;
+    }
+  } while (strm->avail_out == 0);
+
+  return 0;
+}
+
+/**
+ * @brief opens the cache directory and reads the hashes of the cached files
+ *
+ * @param dir the cache directory, created if it does not exist
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int cache_open(const char *dir) {
+  DIR *dp;
+  struct dirent *entry;
+
+  if (mkdir(dir, 0700) == -1 && errno != EEXIST) {
+    warn("mkdir %s", dir);
+    return -1;
+  }
+
+  if ((dp = opendir(dir)) == NULL) {
+    warn("opendir %s", dir);
+    return -1;
+  }
+
+  while ((entry = readdir(dp)) != NULL) {
+    if (cache_add(entry->d_name) == -1) {
+      break; /* the server is told about as many as fit */
+    }
+  }
+
+  closedir(dp);
+
+  v("Cached files: %zu\n", cache.count);
+  return 0;
+}
+
+/**
+ * @brief adds a hash to the list announced to the server
+ *
+ * Names other than hashes are ignored.
+ *
+ * @param hash the hash
+ *
+ * @returns 0 if it was added or ignored or -1 if the list is full
+ */
+static int cache_add(const char *hash) {
+  if (strlen(hash) != HASH_LEN || strspn(hash, "0123456789abcdef") != HASH_LEN) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < cache.count; i++) {
+    if (strcmp(cache.hashes[i], hash) == 0) {
+      return 0;
+    }
+  }
+
+  if (cache.count == MAX_CACHED) {
+    return -1;
+  }
+
+  strcpy(cache.hashes[cache.count++], hash);
+  return 0;
+}
+
+/**
+ * @brief links a file from the cache
+ *
+ * The file is copied if the cache is on another file system.
+ *
+ * @param hash the hash of the file
+ * @param file_name the name of the file
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int cache_fetch(const char *hash, const char *file_name) {
+  char path[PATH_MAX];
+
+  if (strspn(hash, "0123456789abcdef") != HASH_LEN) {
+    warnx("Invalid hash %s", hash);
+    return -1;
+  }
+
+  (void)snprintf(path, sizeof(path), "%s/%s", cache.dir, hash);
+
+  if (unlink(file_name) == -1 && errno != ENOENT) {
+    warn("unlink %s", file_name);
+    return -1;
+  }
+
+  if (link(path, file_name) == -1) {
+    if (errno != EXDEV) {
+      warn("link %s", path);
+      return -1;
+    }
+    return copy_file(path, file_name);
+  }
+
+  return 0;
+}
+
+/**
+ * @brief stores a received file in the cache
+ *
+ * The file is linked into the cache, or copied if the cache is on another
+ * file system. Failing to cache a file is not an error.
+ *
+ * @param hash the hash of the file
+ * @param file_name the name of the file
+ */
+static void cache_store(const char *hash, const char *file_name) {
+  char path[PATH_MAX];
+
+  if (strspn(hash, "0123456789abcdef") != HASH_LEN) {
+    return;
+  }
+
+  (void)snprintf(path, sizeof(path), "%s/%s", cache.dir, hash);
+
+  if (link(file_name, path) == -1 && errno != EEXIST && (errno != EXDEV || copy_file(file_name, path) == -1)) {
+    warn("Not caching %s", file_name);
+    return;
+  }
+
+  v("Stored: %s\n", path);
+  (void)cache_add(hash);
+}
+
+/**
+ * @brief removes a file which may be linked to a cached one
+ *
+ * Writing into it would change the cached file as well, also when the
+ * client runs without the cache.
+ *
+ * @param file_name the name of the file
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int unshare_file(const char *file_name) {
+  struct stat st;
+
+  if (lstat(file_name, &st) == 0 && S_ISREG(st.st_mode) && st.st_nlink > 1 && unlink(file_name) == -1) {
+    warn("unlink %s", file_name);
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief copies a file
+ *
+ * @param from the name of the file to copy
+ * @param to the name of the copy
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int copy_file(const char *from, const char *to) {
+  char buf[BUFSIZ];
+  size_t cnt;
+  FILE *in, *out;
+  int status = 0;
+
+  if ((in = fopen(from, "r")) == NULL) {
+    warn("fopen %s", from);
+    return -1;
+  }
+
+  if ((out = fopen(to, "w")) == NULL) {
+    warn("fopen %s", to);
+    fclose(in);
+    return -1;
+  }
+
+  while ((cnt = fread(buf, sizeof(char), sizeof(buf), in)) > 0) {
+    if (fwrite(buf, sizeof(char), cnt, out) != cnt) {
+      warn("fwrite %s", to);
+      status = -1;
+      break;
+    }
+  }
+
+  if (ferror(in)) {
+    warn("fread %s", from);
+    status = -1;
+  }
+
+  fclose(in);
+  if (fclose(out) == EOF) {
+    warn("fclose %s", to);
+    status = -1;
+  }
+
+  return status;
+}
+
+/**
+ * @brief continues the 64 bit FNV-1a hash of a file, as the server computes it
+ *
+ * @param hash the hash of the preceding contents
+ * @param buf the next contents
+ * @param len the length of the contents
+ *
+ * @returns the hash including the contents
+ */
+static unsigned long long hash_update(unsigned long long hash, const char *buf, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ (unsigned char)buf[i]) * 0x100000001b3ULL;
+  }
+
+  return hash;
 }
 
 /**
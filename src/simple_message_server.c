@@ -1,26 +1,215 @@
+#define _GNU_SOURCE /* accept4(), pthread_setaffinity_np() */
+
+#include "simple_message_server_logic.h"
 #include <err.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
+#include <linux/io_uring.h>
 #include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
 #include <signal.h>
+#include <spawn.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #define SERVER_LOGIC_PATH "/usr/local/bin/simple_message_server_logic"
+#define SERVER_LOGIC_NAME "simple_message_server_logic"
+#define MAX_EVENTS 64
+#define MAX_WORKERS 1024
+#define MAX_CHILDREN 65536
+#define MAXSTATUSLEN 32
+#define MAX_QUEUE 65536
+#define MAX_LINGER 64 /* turned away connections waiting for the client to close */
+#define DEFAULT_TIMEOUT 30 /* seconds */
+#define MAX_TIMEOUT 1000
+#define WHEEL_TICK_MS 100
+#define WHEEL_INNER_BITS 8
+#define WHEEL_INNER_SLOTS (1 << WHEEL_INNER_BITS) /* 25.6 s in ticks */
+#define WHEEL_OUTER_SLOTS 64                      /* 27 min in ticks, enough for MAX_TIMEOUT */
+#define WORKER_MAX_REQUESTS 10000 /* a worker is replaced after that many requests */
+#define URING_ENTRIES 256
+#define URING_BUFFERS 256 /* receive buffers provided to the kernel */
+#define URING_BUFFER_SIZE SMSL_MAXMESSAGELEN
+#define URING_BUFFER_GROUP 0
+#define URING_OP_MASK 7 /* the operation is stored in the low bits of the user_data */
 
 #define v(fmt, ...)                                                                                          \
   if (verbose)                                                                                               \
     fprintf(stderr, "%s(): " fmt, __func__, __VA_ARGS__);
 
+typedef enum { BACKEND_EXEC, BACKEND_INPROC, BACKEND_EPOLL, BACKEND_URING } backend_t;
+
+/* closing: the last response is sent, waiting: a subscribe request waits for new entries */
+typedef enum { CONN_READING, CONN_WRITING, CONN_CLOSING, CONN_WAITING } conn_state;
+
+typedef struct {
+  char *port;
+  backend_t backend;
+  long threads;
+  long workers;
+  long children; /* 0 if unlimited */
+  long queue;
+} options_t;
+
+typedef enum { URING_ACCEPT, URING_RECV, URING_SEND, URING_CLOSE, URING_PROVIDE, URING_CANCEL, URING_WATCH } uring_op;
+
+typedef struct {
+  pthread_t thread;
+  char *port;
+  backend_t backend;
+  int cpu; /* -1 if the thread is not pinned */
+  int status;
+} listener_t;
+
+typedef struct wheel_timer {
+  struct wheel_timer *next; /* NULL if the timer is not armed */
+  struct wheel_timer *prev;
+  uint64_t expires; /* in ticks */
+} wheel_timer_t;
+
+typedef struct {
+  uint64_t now; /* in ticks */
+  wheel_timer_t inner[WHEEL_INNER_SLOTS];
+  wheel_timer_t outer[WHEEL_OUTER_SLOTS]; /* cascaded into inner as the ticks come near */
+} timer_wheel_t;
+
+typedef struct connection {
+  wheel_timer_t timer; /* first member, so an expired timer is the connection */
+  struct connection *next_waiting; /* in the list of waiting connections */
+  struct connection *prev_waiting;
+  int fd;
+  conn_state state;
+  char input[SMSL_MAXINPUTLEN]; /* received but not yet consumed by the logic */
+  size_t input_len;
+  int eof; /* the client shut down its sending direction */
+  smsl_session_t session;
+  smsl_buffer_t response;
+  size_t written;
+} connection_t;
+
+typedef struct {
+  int ctrl; /* Unix socket to the logic process, -1 if it has to be spawned */
+  int idle;
+  time_t started;
+} logic_process_t;
+
+typedef struct {
+  int fd;
+  char *rings; /* submission and completion ring, mapped at once */
+  size_t rings_size;
+  struct io_uring_sqe *sqes;
+  size_t sqes_size;
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_array;
+  unsigned sq_mask;
+  unsigned sq_entries;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  struct io_uring_cqe *cqes;
+  unsigned cq_mask;
+  unsigned pending; /* queued but not yet submitted */
+  char *buffers;
+  timer_wheel_t wheel; /* the deadlines of the connections */
+  int watch; /* the board watch, -1 if subscribe requests are rejected */
+  connection_t *waiting; /* the connections with a waiting subscribe request */
+} uring_t;
+
+extern char **environ;
+
 static int verbose = 0;
 
-static int parse_params(int argc, char *argv[], char *port[]);
-static int init_sock(char *port);
-static int accept_connections(int sock);
-static void sigchild_handler(int sig);
+/* seconds a client may take to send its request and to receive the response, 0 if unlimited */
+static long read_timeout = DEFAULT_TIMEOUT;
+static long write_timeout = DEFAULT_TIMEOUT;
+
+/* the prefork workers or pooled logic processes, a slot is set to 0 by reap_children() once it died */
+static pid_t *worker_pids = NULL;
+static long worker_count = 0;
+
+/* the children or, for the inproc backend, threads of accept_connections() still serving a connection */
+static long children = 0;
+
+/* the eventfd counting the connection threads which finished, -1 unless the inproc backend runs */
+static int finished = -1;
+
+/* the signal mask for the children, the server blocks SIGCHLD and reads it from a signalfd */
+static sigset_t child_mask;
+
+/* print the resource usage of every reaped child */
+static int accounting = 0;
+
+static int parse_params(int argc, char *argv[], options_t *options);
+static int parse_count(const char *arg, long max, long *count);
+static int init_sock(char *port, int reuseport);
+static int init_sigchild(void);
+static int init_threads(void);
+static int accept_connections(int sock, backend_t backend, long max_children, long queue_size);
+static void start_child(int sock, int accept_sock, backend_t backend);
+static void *connection_thread(void *arg);
+static void count_finished(int efd);
+static int reject_busy(int accept_sock);
+static void drain_lingering(struct pollfd *pfd);
+static pid_t exec_logic(int sock, int in, int out, char *const argv[]);
+static void reap_children(int sfd);
+static int prefork_workers(int sock, long workers);
+static pid_t spawn_worker(int sock, const sigset_t *mask);
+static void worker_loop(int sock);
+static int exec_ahead_pool(int sock, long size);
+static pid_t spawn_logic(int sock, int *ctrl);
+static int pass_connection(int ctrl, int fd);
+static void set_timeouts(int fd);
+static int event_loop(int sock);
+static int accept_clients(int epfd, int sock, timer_wheel_t *wheel, int watching);
+static int handle_event(int epfd, connection_t *conn, uint32_t events, timer_wheel_t *wheel, connection_t **waiting);
+static int park_connection(int epfd, connection_t *conn, timer_wheel_t *wheel, connection_t **waiting);
+static void wait_for_entries(connection_t *conn, timer_wheel_t *wheel, connection_t **waiting);
+static void unpark_connection(connection_t *conn, connection_t **waiting);
+static int read_request(connection_t *conn);
+static int process_input(connection_t *conn);
+static int write_response(connection_t *conn);
+static void close_connection(connection_t *conn);
+static uint64_t wheel_ticks(void);
+static void wheel_init(timer_wheel_t *wheel);
+static void wheel_add(timer_wheel_t *wheel, wheel_timer_t *timer, long seconds);
+static void wheel_link(timer_wheel_t *wheel, wheel_timer_t *timer);
+static void wheel_remove(wheel_timer_t *timer);
+static void wheel_expire(timer_wheel_t *wheel, wheel_timer_t *expired);
+static int uring_loop(int sock);
+static int uring_init(uring_t *ring);
+static void uring_exit(uring_t *ring);
+static struct io_uring_sqe *uring_get_sqe(uring_t *ring, uring_op op, void *ptr);
+static int uring_submit(uring_t *ring, unsigned wait);
+static int uring_complete(uring_t *ring, int sock, const struct io_uring_cqe *cqe);
+static int uring_accept(uring_t *ring, int sock);
+static int uring_provide(uring_t *ring, unsigned first, unsigned count);
+static int uring_recv(uring_t *ring, connection_t *conn);
+static int uring_received(uring_t *ring, connection_t *conn, const struct io_uring_cqe *cqe);
+static int uring_send(uring_t *ring, connection_t *conn);
+static int uring_sent(uring_t *ring, connection_t *conn, int res);
+static int uring_respond(uring_t *ring, connection_t *conn);
+static int uring_resume(uring_t *ring, connection_t *conn);
+static int uring_cancel(uring_t *ring, connection_t *conn);
+static int uring_watch(uring_t *ring);
+static void raise_fd_limit(void);
+static int start_listeners(char *port, long threads, backend_t backend);
+static void *listener_thread(void *arg);
 
 /**
  * @brief entry point
@@ -31,22 +220,61 @@ static void sigchild_handler(int sig);
  * @returns EXIT_SUCCESS, EXIT_FAILURE
  */
 int main(int argc, char *argv[]) {
-  char *port = NULL;
+  options_t options = {NULL, BACKEND_EXEC, 0, 0, 0, 0};
   int sock = -1;
 
-  if (parse_params(argc, argv, &port) == -1) {
+  if (parse_params(argc, argv, &options) == -1) {
     /* error is printed by parse_params() */
-    fprintf(stderr, "Usage: %s -p port [-v] [-h]\n", argv[0]);
+    fprintf(stderr, "Usage: %s -p port [-b exec|inproc|epoll|uring] [-t threads] [-w workers]\n"
+                    "       [-c children [-q queue]] [-r read_timeout] [-s send_timeout] [-a] [-v] [-h]\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+  v("port: %s, backend: %d, threads: %ld, workers: %ld, children: %ld, queue: %ld\n", options.port,
+    options.backend, options.threads, options.workers, options.children, options.queue);
+
+  /* the linked-in logic is initialised once instead of on every exec */
+  if (options.backend != BACKEND_EXEC && smsl_init(SERVER_LOGIC_NAME) == -1) {
+    warnx("Could not initialise the server logic");
     return EXIT_FAILURE;
   }
-  v("port: %s\n", port);
 
-  if ((sock = init_sock(port)) == -1) {
+  if (options.threads > 0) {
+    if (start_listeners(options.port, options.threads, options.backend) == -1) {
+      /* error is printed by start_listeners() */
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  if ((sock = init_sock(options.port, 0)) == -1) {
     /* error is printed by init_sock() */
     return EXIT_FAILURE;
   }
 
-  if (accept_connections(sock) == -1) {
+  if (options.workers > 0 && options.backend == BACKEND_EXEC) {
+    if (exec_ahead_pool(sock, options.workers) == -1) {
+      /* error is printed by exec_ahead_pool() */
+      return EXIT_FAILURE;
+    }
+  } else if (options.workers > 0) {
+    if (prefork_workers(sock, options.workers) == -1) {
+      /* error is printed by prefork_workers() */
+      return EXIT_FAILURE;
+    }
+  } else if (options.backend == BACKEND_EPOLL) {
+    raise_fd_limit();
+    if (event_loop(sock) == -1) {
+      /* error is printed by event_loop() */
+      return EXIT_FAILURE;
+    }
+  } else if (options.backend == BACKEND_URING) {
+    raise_fd_limit();
+    if (uring_loop(sock) == -1) {
+      /* error is printed by uring_loop() */
+      return EXIT_FAILURE;
+    }
+  } else if (accept_connections(sock, options.backend, options.children, options.queue) == -1) {
     /* error is printed by accept_connections() */
     return EXIT_FAILURE;
   }
@@ -63,17 +291,25 @@ int main(int argc, char *argv[]) {
  *
  * @param argc the number of arguments
  * @param argv the arguments
- * @param port where to save the port
+ * @param options where to save the options
  *
  * @returns 0 if everything went well or -1 in case of error
  */
-static int parse_params(int argc, char *argv[], char *port[]) {
+static int parse_params(int argc, char *argv[], options_t *options) {
   int opt;
   long port_num;
   char *notconv;
 
   struct option long_options[] = {
       {"port", 1, NULL, 'p'},
+      {"backend", 1, NULL, 'b'},
+      {"threads", 1, NULL, 't'},
+      {"workers", 1, NULL, 'w'},
+      {"children", 1, NULL, 'c'},
+      {"queue", 1, NULL, 'q'},
+      {"read-timeout", 1, NULL, 'r'},
+      {"send-timeout", 1, NULL, 's'},
+      {"accounting", 0, NULL, 'a'},
       {"verbose", 0, NULL, 'v'},
       {"help", 0, NULL, 'h'},
       {0, 0, 0, 0}
@@ -84,7 +320,7 @@ static int parse_params(int argc, char *argv[], char *port[]) {
     return -1;
   }
 
-  while ((opt = getopt_long(argc, argv, "p:vh", long_options, NULL)) != -1) {
+  while ((opt = getopt_long(argc, argv, "p:b:t:w:c:q:r:s:avh", long_options, NULL)) != -1) {
     switch (opt) {
 
     case 'p':
@@ -97,7 +333,72 @@ static int parse_params(int argc, char *argv[], char *port[]) {
         warnx("Invalid port number");
         return -1;
       }
-      *port = optarg;
+      options->port = optarg;
+      break;
+
+    case 'b':
+      if (strcmp(optarg, "exec") == 0) {
+        options->backend = BACKEND_EXEC;
+      } else if (strcmp(optarg, "inproc") == 0) {
+        options->backend = BACKEND_INPROC;
+      } else if (strcmp(optarg, "epoll") == 0) {
+        options->backend = BACKEND_EPOLL;
+      } else if (strcmp(optarg, "uring") == 0) {
+        options->backend = BACKEND_URING;
+      } else {
+        warnx("Invalid backend");
+        return -1;
+      }
+      break;
+
+    case 't':
+      if (parse_count(optarg, CPU_SETSIZE, &options->threads) == -1) {
+        warnx("Invalid number of threads");
+        return -1;
+      }
+      break;
+
+    case 'w':
+      if (parse_count(optarg, MAX_WORKERS, &options->workers) == -1) {
+        warnx("Invalid number of workers");
+        return -1;
+      }
+      break;
+
+    case 'c':
+      if (parse_count(optarg, MAX_CHILDREN, &options->children) == -1) {
+        warnx("Invalid number of children");
+        return -1;
+      }
+      break;
+
+    case 'q':
+      if (parse_count(optarg, MAX_QUEUE, &options->queue) == -1) {
+        warnx("Invalid queue length");
+        return -1;
+      }
+      break;
+
+    case 'r':
+      if (strcmp(optarg, "0") == 0) {
+        read_timeout = 0;
+      } else if (parse_count(optarg, MAX_TIMEOUT, &read_timeout) == -1) {
+        warnx("Invalid read timeout");
+        return -1;
+      }
+      break;
+
+    case 's':
+      if (strcmp(optarg, "0") == 0) {
+        write_timeout = 0;
+      } else if (parse_count(optarg, MAX_TIMEOUT, &write_timeout) == -1) {
+        warnx("Invalid send timeout");
+        return -1;
+      }
+      break;
+
+    case 'a':
+      accounting = 1;
       break;
 
     case 'v':
@@ -118,17 +419,65 @@ static int parse_params(int argc, char *argv[], char *port[]) {
     return -1;
   }
 
+  if (options->threads > 0 && options->backend != BACKEND_EPOLL && options->backend != BACKEND_URING) {
+    warnx("Listener threads require the epoll or uring backend");
+    return -1;
+  }
+
+  if (options->workers > 0 && options->backend != BACKEND_EXEC && options->backend != BACKEND_INPROC) {
+    warnx("Worker processes require the exec or inproc backend");
+    return -1;
+  }
+
+  if (options->children > 0 &&
+      (options->workers > 0 || (options->backend != BACKEND_EXEC && options->backend != BACKEND_INPROC))) {
+    warnx("The number of children can only be limited for the exec or inproc backend without workers");
+    return -1;
+  }
+
+  if (options->queue > 0 && options->children == 0) {
+    warnx("The queue requires a limited number of children");
+    return -1;
+  }
+
+  /* by default as many connections may wait as are served */
+  if (options->queue == 0) {
+    options->queue = options->children;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief parses a positive number
+ *
+ * @param arg the string to parse
+ * @param max the largest allowed value
+ * @param count where to save the number
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int parse_count(const char *arg, long max, long *count) {
+  char *notconv;
+
+  errno = 0;
+  *count = strtol(arg, &notconv, 10);
+  if (errno != 0 || *notconv != '\0' || *count < 1 || *count > max) {
+    return -1;
+  }
+
   return 0;
 }
 
 /**
- * @brief creates a socket and binds to it
+ * @brief creates a socket, binds to it and marks it as passive
  *
  * @param port the port number
+ * @param reuseport whether other sockets may bind to the same port
  *
  * @returns the socket descriptor or -1 in case of error
  */
-static int init_sock(char *port) {
+static int init_sock(char *port, int reuseport) {
   int sock = -1;
   struct addrinfo hints;
   struct addrinfo *info, *p;
@@ -167,6 +516,13 @@ static int init_sock(char *port) {
       continue;
     }
 
+    /* let the kernel spread the connections over all listeners */
+    if (reuseport && setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &reuseport, sizeof(int)) == -1) {
+      warn("setsockopt");
+      close(sock);
+      continue;
+    }
+
     if (bind(sock, p->ai_addr, p->ai_addrlen) == -1) {
       warn("bind");
       close(sock);
@@ -185,94 +541,2209 @@ static int init_sock(char *port) {
   freeaddrinfo(info);
 
   v("%s\n", "bind() successful");
+
+  /* mark the socket as passive with a maximum backlog allowed by OS */
+  if (listen(sock, SOMAXCONN) == -1) {
+    warn("listen");
+    close(sock);
+    return -1;
+  }
+  v("%s\n", "Listening...");
+
   return sock;
 }
 
 /**
- * @brief a forking server
+ * @brief blocks SIGCHLD and opens a signalfd to reap the children from the main loop
+ *
+ * @returns the signalfd or -1 in case of error
+ */
+static int init_sigchild(void) {
+  sigset_t mask;
+  int sfd;
+
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCHLD);
+  if (sigprocmask(SIG_BLOCK, &mask, &child_mask) == -1) {
+    warn("sigprocmask");
+    return -1;
+  }
+
+  if ((sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC)) == -1) {
+    warn("signalfd");
+    return -1;
+  }
+
+  return sfd;
+}
+
+/**
+ * @brief prepares the server to handle connections on threads of its own
+ *
+ * A closed connection must not kill the server, and the threads report
+ * their end over an eventfd read in the main loop.
+ *
+ * @returns the eventfd or -1 in case of error
+ */
+static int init_threads(void) {
+  struct sigaction sa;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = SIG_IGN;
+  sigemptyset(&sa.sa_mask);
+  if (sigaction(SIGPIPE, &sa, NULL) == -1) {
+    warn("sigaction");
+    return -1;
+  }
+
+  if ((finished = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+    warn("eventfd");
+    return -1;
+  }
+
+  return finished;
+}
+
+/**
+ * @brief a server handing every connection to a child or, for the inproc backend, a thread
+ *
+ * If the number of children is limited, the connections above the limit
+ * wait in a bounded queue and are admitted as children finish. Once the
+ * queue is full, the connections are turned away with a busy status.
  *
  * @param sock the server socket
+ * @param backend how the children handle the connection
+ * @param max_children the maximum number of children or 0 if unlimited
+ * @param queue_size the maximum number of waiting connections
  *
  * @returns 0 if everything went well or -1 in case of error
  */
-static int accept_connections(int sock) {
+static int accept_connections(int sock, backend_t backend, long max_children, long queue_size) {
   int accept_sock = -1;
+  int *queue = NULL;
+  long head = 0;
+  long queued = 0;
   struct sockaddr_in addr;
   socklen_t addr_size = sizeof(struct sockaddr_in);
+  struct pollfd fds[2 + MAX_LINGER];
+  struct pollfd *lingering = fds + 2;
+  int next_linger = 0;
+  int sfd = -1;
+  int i;
 
-  /* set up a signal handler */
-  struct sigaction sa;
-  sa.sa_handler = sigchild_handler;
-  sigemptyset(&sa.sa_mask);
-  sa.sa_flags = SA_RESTART; /* resume library functions after the handler */
-
-  if (sigaction(SIGCHLD, &sa, NULL) == -1) {
-    warn("sigaction");
-    close(sock);
-    return -1;
+  /* the loop only runs once all of these succeeded */
+  if (queue_size > 0 && (queue = calloc((size_t)queue_size, sizeof(int))) == NULL) {
+    warn("calloc");
+  } else if (fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK) == -1) {
+    /* a connection aborted before accept() must not block the loop */
+    warn("fcntl");
+  } else if (backend == BACKEND_INPROC && (sfd = init_threads()) == -1) {
+    /* error is printed by init_threads() */
+  } else if (backend != BACKEND_INPROC && (sfd = init_sigchild()) == -1) {
+    /* error is printed by init_sigchild() */
   }
 
-  /* mark the socket as passive with a maximum backlog allowed by OS */
-  if (listen(sock, SOMAXCONN) == -1) {
-    warn("listen");
-    close(sock);
-    return -1;
+  /* the server socket and the signalfd or eventfd are followed by the turned away connections */
+  for (i = 0; i < 2 + MAX_LINGER; i++) {
+    fds[i].fd = -1;
+    fds[i].events = POLLIN;
   }
-  v("%s\n", "Listening...");
+  fds[0].fd = sock;
+  fds[1].fd = sfd;
+
+  while (sfd != -1) {
+    /* admit the waiting connections as children finish */
+    while (queued > 0 && children < max_children) {
+      start_child(sock, queue[head], backend);
+      head = (head + 1) % queue_size;
+      queued--;
+    }
 
-  while (1) {
     v("%s\n", "Waiting for connections...");
-    if ((accept_sock = accept(sock, (struct sockaddr *)&addr, &addr_size)) == -1) {
-      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+    if (poll(fds, 2 + MAX_LINGER, -1) == -1) {
+      if (errno == EINTR) {
         continue;
+      }
+      warn("poll");
+      break;
+    }
+
+    /* the waiting connections are admitted before any new one */
+    if (fds[1].revents != 0) {
+      if (backend == BACKEND_INPROC) {
+        count_finished(sfd);
       } else {
-        warn("accept");
-        close(sock);
-        return -1;
+        reap_children(sfd);
       }
+      continue;
     }
-    v("%s\n", "Accepted a connection");
 
-    switch (fork()) {
+    for (i = 0; i < MAX_LINGER; i++) {
+      if (lingering[i].fd != -1 && lingering[i].revents != 0) {
+        drain_lingering(&lingering[i]);
+      }
+    }
 
-    case -1: /* error */
-      warn("fork");
-      close(accept_sock);
-      break;
+    if (!(fds[0].revents & POLLIN)) {
+      continue;
+    }
 
-    case 0: /* child */
-      close(sock);
-      if (dup2(accept_sock, STDIN_FILENO) == -1) {
-        warn("dup2 in");
-        _exit(EXIT_FAILURE);
+    if ((accept_sock = accept4(sock, (struct sockaddr *)&addr, &addr_size, SOCK_CLOEXEC)) == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      } else {
+        warn("accept");
+        break;
       }
-      if (dup2(accept_sock, STDOUT_FILENO) == -1) {
-        warn("dup2 out");
-        _exit(EXIT_FAILURE);
+    }
+    v("%s\n", "Accepted a connection");
+
+    if (max_children == 0 || children < max_children) {
+      start_child(sock, accept_sock, backend);
+    } else if (queued < queue_size) {
+      queue[(head + queued) % queue_size] = accept_sock;
+      queued++;
+      v("Connection queued, %ld waiting\n", queued);
+    } else {
+      v("%s\n", "Queue full, connection turned away");
+      if (reject_busy(accept_sock) == 0) {
+        /* the longest lingering connection has to go if there is no room */
+        if (lingering[next_linger].fd != -1) {
+          close(lingering[next_linger].fd);
+        }
+        lingering[next_linger].fd = accept_sock;
+        next_linger = (next_linger + 1) % MAX_LINGER;
       }
-      close(accept_sock);
-      execl(SERVER_LOGIC_PATH, "", NULL);
-      /* reached only if execl() failed */
-      warn("execl");
-      _exit(EXIT_FAILURE);
+    }
+  }
+
+  /* only reached in case of error */
+  for (i = 0; i < MAX_LINGER; i++) {
+    if (lingering[i].fd != -1) {
+      close(lingering[i].fd);
+    }
+  }
+  for (; queued > 0; queued--) {
+    close(queue[head]);
+    head = (head + 1) % queue_size;
+  }
+  if (sfd != -1) {
+    close(sfd);
+  }
+  free(queue);
+  close(sock);
+
+  return -1;
+}
+
+/**
+ * @brief hands a connection to a new child or, for the inproc backend, a new thread
+ *
+ * The linked-in logic is initialised once and keeps the state of a
+ * connection per thread, so the inproc backend needs no process of its
+ * own for a connection.
+ *
+ * @param sock the server socket
+ * @param accept_sock the connected socket, closed in the parent or by the thread
+ * @param backend how the child handles the connection
+ */
+static void start_child(int sock, int accept_sock, backend_t backend) {
+  char *const argv[] = {"", NULL};
+  pthread_t thread;
 
-    default: /* parent */
+  set_timeouts(accept_sock);
+
+  if (backend == BACKEND_INPROC) {
+    if ((errno = pthread_create(&thread, NULL, connection_thread, (void *)(intptr_t)accept_sock)) != 0) {
+      warn("pthread_create");
       close(accept_sock);
-      break;
+      return;
     }
+    pthread_detach(thread);
+    children++;
+    return;
   }
 
-  /* not reached */
+  /* error is printed by exec_logic(), the connection is lost */
+  if (exec_logic(sock, accept_sock, accept_sock, argv) != -1) {
+    children++;
+  }
+  close(accept_sock);
+}
+
+/**
+ * @brief handles a connection with the linked-in logic
+ *
+ * With accounting, the resource usage of the thread is printed.
+ *
+ * @param arg the connected socket
+ *
+ * @returns NULL, the end is counted on the eventfd finished
+ */
+static void *connection_thread(void *arg) {
+  int accept_sock = (int)(intptr_t)arg;
+  uint64_t one = 1;
+  struct rusage usage;
+  int rc;
+
+  rc = smsl_handle_connection(accept_sock);
+  close(accept_sock);
+
+  if (accounting && getrusage(RUSAGE_THREAD, &usage) == 0) {
+    fprintf(stderr, "tid=%ld status=%d utime=%ld.%06ld stime=%ld.%06ld maxrss=%ld\n", (long)syscall(SYS_gettid),
+            (rc == -1) ? EXIT_FAILURE : EXIT_SUCCESS, (long)usage.ru_utime.tv_sec, (long)usage.ru_utime.tv_usec,
+            (long)usage.ru_stime.tv_sec, (long)usage.ru_stime.tv_usec, usage.ru_maxrss);
+  }
+
+  while (write(finished, &one, sizeof(one)) == -1 && errno == EINTR) {
+    /* retry */
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief counts the connection threads which finished once the eventfd is readable
+ *
+ * @param efd the eventfd
+ */
+static void count_finished(int efd) {
+  uint64_t count;
+
+  if (read(efd, &count, sizeof(count)) == sizeof(count)) {
+    children -= (long)count;
+  }
+}
+
+/**
+ * @brief turns a connection away with a busy status
+ *
+ * The status is sent without reading the request. The socket must not
+ * be closed before the client has sent all of its request, otherwise the
+ * connection is reset and the client may never see the status.
+ *
+ * @param accept_sock the connected socket
+ *
+ * @returns 0 if the socket has to be drained by drain_lingering() or -1 if it is closed
+ */
+static int reject_busy(int accept_sock) {
+  char buf[MAXSTATUSLEN];
+  int len;
+
+  len = snprintf(buf, sizeof(buf), "status=%d\n", SMSL_STATUS_BUSY);
+
+  if (fcntl(accept_sock, F_SETFL, fcntl(accept_sock, F_GETFL) | O_NONBLOCK) == -1 ||
+      send(accept_sock, buf, (size_t)len, MSG_NOSIGNAL) == -1 || shutdown(accept_sock, SHUT_WR) == -1) {
+    warn("send");
+    close(accept_sock);
+    return -1;
+  }
 
   return 0;
 }
 
 /**
- * @brief handles SIGCHLD by waiting for dead processes
+ * @brief discards what a turned away client sent and closes its socket at EOF
+ *
+ * @param pfd the poll entry of the socket, reset once the socket is closed
+ */
+static void drain_lingering(struct pollfd *pfd) {
+  char buf[SMSL_MAXMESSAGELEN];
+  ssize_t cnt;
+
+  while ((cnt = read(pfd->fd, buf, sizeof(buf))) > 0) {
+    /* discard */
+  }
+
+  if (cnt == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+    close(pfd->fd);
+    pfd->fd = -1;
+  }
+}
+
+/**
+ * @brief executes the logic with stdin and stdout redirected
+ *
+ * posix_spawn() does not copy the page tables of the server like fork()
+ * (glibc uses clone() with CLONE_VM and CLONE_VFORK), which would be
+ * wasted on a child executing the logic right away. The redirection is
+ * done by file actions in the child.
+ *
+ * @param sock the server socket, not inherited by the logic
+ * @param in the descriptor to become stdin
+ * @param out the descriptor to become stdout or -1 to keep stdout
+ * @param argv the arguments of the logic
+ *
+ * @returns the pid of the logic or -1 in case of error
+ */
+static pid_t exec_logic(int sock, int in, int out, char *const argv[]) {
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attr;
+  pid_t pid;
+
+  if ((errno = posix_spawnattr_init(&attr)) != 0) {
+    warn("posix_spawnattr_init");
+    return -1;
+  }
+
+  /* SIGCHLD is blocked in the server only */
+  if ((errno = posix_spawnattr_setsigmask(&attr, &child_mask)) != 0 ||
+      (errno = posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK)) != 0) {
+    warn("posix_spawnattr");
+    posix_spawnattr_destroy(&attr);
+    return -1;
+  }
+
+  if ((errno = posix_spawn_file_actions_init(&actions)) != 0) {
+    warn("posix_spawn_file_actions_init");
+    posix_spawnattr_destroy(&attr);
+    return -1;
+  }
+
+  if ((errno = posix_spawn_file_actions_adddup2(&actions, in, STDIN_FILENO)) != 0 ||
+      (out != -1 && (errno = posix_spawn_file_actions_adddup2(&actions, out, STDOUT_FILENO)) != 0) ||
+      (errno = posix_spawn_file_actions_addclose(&actions, in)) != 0 ||
+      (out != -1 && out != in && (errno = posix_spawn_file_actions_addclose(&actions, out)) != 0) ||
+      (errno = posix_spawn_file_actions_addclose(&actions, sock)) != 0) {
+    warn("posix_spawn_file_actions");
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    return -1;
+  }
+
+  if ((errno = posix_spawn(&pid, SERVER_LOGIC_PATH, &actions, &attr, argv, environ)) != 0) {
+    warn("posix_spawn");
+    pid = -1;
+  }
+
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attr);
+
+  return pid;
+}
+
+/**
+ * @brief reaps the dead children once the signalfd is readable
+ *
+ * Dead prefork workers and pooled logic processes are marked for their
+ * replacement, any other child has finished its connection. With
+ * accounting, the resource usage of every child is printed.
  *
- * @param sig the signal number (ignored)
+ * @param sfd the signalfd
  */
-static void sigchild_handler(int sig) {
-  (void)sig;
-  while (waitpid(-1, NULL, WNOHANG) > 0);
+static void reap_children(int sfd) {
+  struct signalfd_siginfo info;
+  struct rusage usage;
+  int status;
+  pid_t pid;
+  long i;
+
+  /* pending signals are merged, wait4() is looped until no child is left to reap */
+  while (read(sfd, &info, sizeof(info)) == sizeof(info)) {
+    /* drain */
+  }
+
+  while ((pid = wait4(-1, &status, WNOHANG, &usage)) > 0) {
+    for (i = 0; i < worker_count; i++) {
+      if (worker_pids[i] == pid) {
+        worker_pids[i] = 0;
+        break;
+      }
+    }
+    if (i == worker_count) {
+      children--;
+    }
+
+    if (accounting) {
+      fprintf(stderr, "pid=%d status=%d utime=%ld.%06ld stime=%ld.%06ld maxrss=%ld\n", (int)pid,
+              WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status), (long)usage.ru_utime.tv_sec,
+              (long)usage.ru_utime.tv_usec, (long)usage.ru_stime.tv_sec, (long)usage.ru_stime.tv_usec,
+              usage.ru_maxrss);
+    }
+  }
+}
+
+/**
+ * @brief a preforking server
+ *
+ * The workers share the listening socket and handle the connections
+ * in-process, one after the other. Dead workers are replaced.
+ *
+ * @param sock the server socket
+ * @param workers the number of workers
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int prefork_workers(int sock, long workers) {
+  struct pollfd pfd;
+  time_t *started;
+  pid_t pid;
+  long i;
+
+  if ((worker_pids = calloc((size_t)workers, sizeof(pid_t))) == NULL ||
+      (started = calloc((size_t)workers, sizeof(time_t))) == NULL) {
+    warn("calloc");
+    close(sock);
+    return -1;
+  }
+  worker_count = workers;
+
+  if ((pfd.fd = init_sigchild()) == -1) {
+    /* error is printed by init_sigchild() */
+    close(sock);
+    return -1;
+  }
+  pfd.events = POLLIN;
+
+  while (1) {
+    for (i = 0; i < workers; i++) {
+      if (worker_pids[i] != 0) {
+        continue;
+      }
+
+      /* do not spin if a worker keeps dying right away */
+      if (started[i] == time(NULL)) {
+        sleep(1);
+      }
+      started[i] = time(NULL);
+
+      if ((pid = spawn_worker(sock, &child_mask)) == -1) {
+        break; /* retried on the next round */
+      }
+      worker_pids[i] = pid;
+      v("Worker %ld started with pid %d\n", i, (int)pid);
+    }
+
+    if (poll(&pfd, 1, -1) == -1 && errno != EINTR) {
+      warn("poll");
+      close(sock);
+      return -1;
+    }
+    reap_children(pfd.fd);
+  }
+
+  /* not reached */
+
+  return 0;
+}
+
+/**
+ * @brief forks a worker
+ *
+ * @param sock the server socket
+ * @param mask the signal mask for the worker
+ *
+ * @returns the pid of the worker or -1 in case of error
+ */
+static pid_t spawn_worker(int sock, const sigset_t *mask) {
+  struct sigaction sa;
+  pid_t pid;
+
+  switch (pid = fork()) {
+
+  case -1: /* error */
+    warn("fork");
+    return -1;
+
+  case 0: /* child */
+    /* a closed connection must not kill the worker */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_IGN;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGPIPE, &sa, NULL);
+
+    sigprocmask(SIG_SETMASK, mask, NULL);
+
+    /* do not outlive the supervisor */
+    if (prctl(PR_SET_PDEATHSIG, SIGTERM) == -1 || getppid() == 1) {
+      _exit(EXIT_FAILURE);
+    }
+
+    worker_loop(sock);
+    (void)smsl_sync_board();
+    _exit(EXIT_SUCCESS);
+
+  default: /* parent */
+    return pid;
+  }
+}
+
+/**
+ * @brief accepts and handles connections until WORKER_MAX_REQUESTS are served
+ *
+ * @param sock the server socket
+ */
+static void worker_loop(int sock) {
+  int accept_sock = -1;
+  long requests;
+
+  for (requests = 0; requests < WORKER_MAX_REQUESTS; requests++) {
+    if ((accept_sock = accept(sock, NULL, NULL)) == -1) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      warn("accept");
+      (void)smsl_sync_board();
+      _exit(EXIT_FAILURE);
+    }
+
+    set_timeouts(accept_sock);
+    smsl_handle_connection(accept_sock);
+    close(accept_sock);
+  }
+}
+
+/**
+ * @brief a server passing the connections to a pool of warm logic processes
+ *
+ * The logic processes are executed and initialised ahead of time and
+ * receive the connected sockets over a Unix socket with SCM_RIGHTS. A
+ * process reports back with one byte once it has served the connection.
+ * Connections are only accepted while a process is idle, the others wait
+ * in the backlog. Dead processes are replaced.
+ *
+ * @param sock the server socket
+ * @param size the number of logic processes
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int exec_ahead_pool(int sock, long size) {
+  logic_process_t *procs;
+  struct pollfd *fds;
+  int accept_sock = -1;
+  int sfd = -1;
+  long idle = 0;
+  long i;
+  pid_t pid;
+  ssize_t cnt;
+  char done;
+
+  if ((worker_pids = calloc((size_t)size, sizeof(pid_t))) == NULL ||
+      (procs = calloc((size_t)size, sizeof(logic_process_t))) == NULL ||
+      (fds = calloc((size_t)size + 2, sizeof(struct pollfd))) == NULL) {
+    warn("calloc");
+    close(sock);
+    return -1;
+  }
+  worker_count = size;
+
+  for (i = 0; i < size; i++) {
+    procs[i].ctrl = -1;
+  }
+
+  /* a connection aborted before accept() must not block the loop */
+  if (fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK) == -1) {
+    warn("fcntl");
+    close(sock);
+    return -1;
+  }
+
+  if ((sfd = init_sigchild()) == -1) {
+    /* error is printed by init_sigchild() */
+    close(sock);
+    return -1;
+  }
+
+  /* the server socket and the logic processes are followed by the signalfd */
+  fds[size + 1].fd = sfd;
+  fds[size + 1].events = POLLIN;
+
+  while (1) {
+    for (i = 0; i < size; i++) {
+      /* a slot is reused once reap_children() has cleared the pid of its dead process */
+      if (procs[i].ctrl != -1 || worker_pids[i] != 0) {
+        continue;
+      }
+
+      /* do not spin if a process keeps dying right away */
+      if (procs[i].started == time(NULL)) {
+        sleep(1);
+      }
+      procs[i].started = time(NULL);
+
+      if ((pid = spawn_logic(sock, &procs[i].ctrl)) == -1) {
+        break; /* retried on the next round */
+      }
+      worker_pids[i] = pid;
+      procs[i].idle = 1;
+      idle++;
+      v("Logic process %ld started with pid %d\n", i, (int)pid);
+    }
+
+    /* without an idle process the connections stay in the backlog */
+    fds[0].fd = (idle > 0) ? sock : -1;
+    fds[0].events = POLLIN;
+    for (i = 0; i < size; i++) {
+      fds[i + 1].fd = procs[i].ctrl;
+      fds[i + 1].events = POLLIN;
+    }
+
+    if (poll(fds, (nfds_t)size + 2, -1) == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      warn("poll");
+      close(sock);
+      return -1;
+    }
+
+    if (fds[size + 1].revents != 0) {
+      reap_children(sfd);
+    }
+
+    for (i = 0; i < size; i++) {
+      if (fds[i + 1].fd == -1 || fds[i + 1].revents == 0) {
+        continue;
+      }
+
+      if ((cnt = recv(procs[i].ctrl, &done, sizeof(done), MSG_DONTWAIT)) == 1) {
+        if (!procs[i].idle) {
+          procs[i].idle = 1;
+          idle++;
+        }
+      } else if (cnt == 0 || (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        /* the process died, it is reaped by reap_children() */
+        v("Logic process %ld is gone\n", i);
+        close(procs[i].ctrl);
+        procs[i].ctrl = -1;
+        if (procs[i].idle) {
+          procs[i].idle = 0;
+          idle--;
+        }
+      }
+    }
+
+    if (fds[0].fd == -1 || !(fds[0].revents & POLLIN)) {
+      continue;
+    }
+
+    for (i = 0; i < size && idle > 0; i++) {
+      if (!procs[i].idle) {
+        continue;
+      }
+
+      if ((accept_sock = accept4(sock, NULL, NULL, SOCK_CLOEXEC)) == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED) {
+          break;
+        }
+        warn("accept4");
+        close(sock);
+        return -1;
+      }
+      v("%s\n", "Accepted a connection");
+
+      set_timeouts(accept_sock);
+      if (pass_connection(procs[i].ctrl, accept_sock) == -1) {
+        /* the connection is lost, the process is replaced */
+        close(procs[i].ctrl);
+        procs[i].ctrl = -1;
+      }
+      close(accept_sock);
+      procs[i].idle = 0;
+      idle--;
+    }
+  }
+
+  /* not reached */
+
+  return 0;
+}
+
+/**
+ * @brief executes a logic process serving passed connections
+ *
+ * @param sock the server socket, not inherited by the logic process
+ * @param ctrl where to save the Unix socket to the logic process
+ *
+ * @returns the pid of the logic process or -1 in case of error
+ */
+static pid_t spawn_logic(int sock, int *ctrl) {
+  int sv[2];
+  pid_t pid;
+  char *const argv[] = {SERVER_LOGIC_NAME, "--pool", NULL};
+
+  /* the server's end is closed by the exec */
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1) {
+    warn("socketpair");
+    return -1;
+  }
+
+  if ((pid = exec_logic(sock, sv[1], -1, argv)) == -1) {
+    /* error is printed by exec_logic() */
+    close(sv[0]);
+  } else {
+    *ctrl = sv[0];
+  }
+  close(sv[1]);
+
+  return pid;
+}
+
+/**
+ * @brief passes a connected socket to a logic process
+ *
+ * @param ctrl the Unix socket to the logic process
+ * @param fd the connected socket
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int pass_connection(int ctrl, int fd) {
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int))];
+  } control;
+  char byte = 0;
+
+  memset(&msg, 0, sizeof(msg));
+  memset(&control, 0, sizeof(control));
+  iov.iov_base = &byte;
+  iov.iov_len = sizeof(byte);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+  while (sendmsg(ctrl, &msg, MSG_NOSIGNAL) == -1) {
+    if (errno == EINTR) {
+      continue;
+    }
+    warn("sendmsg");
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief tells the logic how long a client may take for a request and its response
+ *
+ * The socket options bound every single read and write, the logic reads
+ * them back and shortens them to deadlines for the whole request and
+ * response, so a client trickling in its request is caught as well.
+ *
+ * @param fd the connected socket
+ */
+static void set_timeouts(int fd) {
+  struct timeval tv;
+
+  memset(&tv, 0, sizeof(tv));
+  tv.tv_sec = read_timeout;
+  if (read_timeout > 0 && setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == -1) {
+    warn("setsockopt");
+  }
+
+  tv.tv_sec = write_timeout;
+  if (write_timeout > 0 && setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) == -1) {
+    warn("setsockopt");
+  }
+}
+
+/**
+ * @brief a single-process server multiplexing all connections with epoll
+ *
+ * The connections which did not send their request or receive their
+ * response in time are closed by a timer wheel, which costs O(1) per
+ * connection and tick.
+ *
+ * @param sock the server socket
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int event_loop(int sock) {
+  struct epoll_event ev;
+  struct epoll_event events[MAX_EVENTS];
+  timer_wheel_t wheel;
+  wheel_timer_t expired;
+  connection_t *waiting = NULL;
+  connection_t *conn;
+  connection_t *next;
+  int epfd = -1;
+  int watch = -1;
+  int changed;
+  int nfds;
+  int i;
+
+  wheel_init(&wheel);
+
+  /* accept_clients() drains the backlog until it would block */
+  if (fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK) == -1) {
+    warn("fcntl");
+    close(sock);
+    return -1;
+  }
+
+  if ((epfd = epoll_create1(0)) == -1) {
+    warn("epoll_create1");
+    close(sock);
+    return -1;
+  }
+
+  /* the listening socket is identified by a NULL pointer */
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;
+
+  if (epoll_ctl(epfd, EPOLL_CTL_ADD, sock, &ev) == -1) {
+    warn("epoll_ctl");
+    close(epfd);
+    close(sock);
+    return -1;
+  }
+
+  /* the board watch is identified by its own address, without it subscribe requests are rejected */
+  if ((watch = smsl_watch_board()) != -1) {
+    ev.data.ptr = &watch;
+
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, watch, &ev) == -1) {
+      warn("epoll_ctl");
+      close(watch);
+      watch = -1;
+    }
+  }
+
+  while (1) {
+    if ((nfds = epoll_wait(epfd, events, MAX_EVENTS, WHEEL_TICK_MS)) == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      warn("epoll_wait");
+      close(epfd);
+      close(sock);
+      return -1;
+    }
+
+    changed = 0;
+    for (i = 0; i < nfds; i++) {
+      if (events[i].data.ptr == NULL) {
+        if (accept_clients(epfd, sock, &wheel, watch != -1) == -1) {
+          close(epfd);
+          close(sock);
+          return -1;
+        }
+      } else if (events[i].data.ptr == &watch) {
+        changed = (smsl_board_changed(watch) == 1);
+      } else if (handle_event(epfd, events[i].data.ptr, events[i].events, &wheel, &waiting) != 0) {
+        close_connection(events[i].data.ptr);
+      }
+    }
+
+    /* after the events, which may still refer to connections closed on the way */
+    for (conn = changed ? waiting : NULL; conn != NULL; conn = next) {
+      next = conn->next_waiting;
+      if (handle_event(epfd, conn, 0, &wheel, &waiting) != 0) {
+        close_connection(conn);
+      }
+    }
+
+    wheel_expire(&wheel, &expired);
+    while (expired.next != &expired) {
+      conn = (connection_t *)expired.next;
+      wheel_remove(&conn->timer);
+
+      /* a subscribe request which waited long enough is answered */
+      if (conn->state == CONN_WAITING) {
+        if (handle_event(epfd, conn, 0, &wheel, &waiting) != 0) {
+          close_connection(conn);
+        }
+        continue;
+      }
+
+      v("%s\n", "Deadline passed, closing the connection");
+      close_connection(conn);
+    }
+  }
+
+  /* not reached */
+
+  return 0;
+}
+
+/**
+ * @brief accepts all pending connections and registers them with epoll
+ *
+ * @param epfd the epoll instance
+ * @param sock the server socket
+ * @param wheel the timer wheel the read deadline is armed in
+ * @param watching nonzero if the bulletin board is watched for subscribe requests
+ *
+ * @returns 0 if everything went well or -1 in case of a fatal error
+ */
+static int accept_clients(int epfd, int sock, timer_wheel_t *wheel, int watching) {
+  struct epoll_event ev;
+  connection_t *conn;
+  int accept_sock;
+
+  while (1) {
+    if ((accept_sock = accept4(sock, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) == -1) {
+      switch (errno) {
+      case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+      case EWOULDBLOCK:
+#endif
+        return 0; /* no more pending connections */
+      case EINTR:
+      case ECONNABORTED:
+      case EMFILE:
+      case ENFILE:
+      case ENOBUFS:
+      case ENOMEM:
+        /* the connection is lost or retried on the next event */
+        warn("accept4");
+        return 0;
+      default:
+        warn("accept4");
+        return -1;
+      }
+    }
+    v("%s\n", "Accepted a connection");
+
+    if ((conn = calloc(1, sizeof(connection_t))) == NULL) {
+      warn("calloc");
+      close(accept_sock);
+      continue;
+    }
+    conn->fd = accept_sock;
+    conn->state = CONN_READING;
+    conn->session.watching = watching;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = conn;
+
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, accept_sock, &ev) == -1) {
+      warn("epoll_ctl");
+      close_connection(conn);
+      continue;
+    }
+
+    wheel_add(wheel, &conn->timer, read_timeout);
+  }
+}
+
+/**
+ * @brief advances a connection after epoll reported it ready
+ *
+ * A waiting connection is advanced without events once the bulletin
+ * board changed or its wait is over, any event means the client is gone.
+ *
+ * @param epfd the epoll instance
+ * @param conn the connection
+ * @param events the events reported by epoll, 0 to resume a waiting connection
+ * @param wheel the timer wheel the deadlines are armed in
+ * @param waiting the list of waiting connections
+ *
+ * @returns 0 if the connection stays open or 1 if it is done and can be closed
+ */
+static int handle_event(int epfd, connection_t *conn, uint32_t events, timer_wheel_t *wheel, connection_t **waiting) {
+  struct epoll_event ev;
+  int status;
+
+  if (conn->state == CONN_WAITING) {
+    unpark_connection(conn, waiting);
+    if (events != 0) {
+      return 1;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = conn;
+
+    if (epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &ev) == -1) {
+      warn("epoll_ctl");
+      return 1;
+    }
+    conn->state = CONN_READING;
+
+    if (process_input(conn) == -1) {
+      return 1;
+    }
+  } else if (events & EPOLLERR) {
+    return 1;
+  } else if (conn->state == CONN_READING && (read_request(conn) == -1 || process_input(conn) == -1)) {
+    return 1;
+  }
+
+  if (conn->state == CONN_READING) {
+    if (conn->response.len == 0) {
+      if (conn->session.wait_until != 0) {
+        return park_connection(epfd, conn, wheel, waiting);
+      }
+      return conn->session.done; /* more of the request is expected */
+    }
+
+    /* most responses fit into the socket buffer, try right away */
+    if ((status = write_response(conn)) == -1) {
+      return 1;
+    }
+
+    if (status == 0) {
+      memset(&ev, 0, sizeof(ev));
+      ev.events = EPOLLOUT;
+      ev.data.ptr = conn;
+
+      if (epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &ev) == -1) {
+        warn("epoll_ctl");
+        return 1;
+      }
+      conn->state = CONN_WRITING;
+
+      wheel_remove(&conn->timer);
+      wheel_add(wheel, &conn->timer, write_timeout);
+      return 0;
+    }
+  } else if ((status = write_response(conn)) != 1) {
+    return (status == -1) ? 1 : 0;
+  }
+
+  /* everything is answered, wait for the next request */
+  conn->response.len = 0;
+  conn->written = 0;
+  if (conn->session.done) {
+    return 1;
+  }
+
+  if (conn->session.wait_until != 0) {
+    return park_connection(epfd, conn, wheel, waiting);
+  }
+
+  if (conn->state == CONN_WRITING) {
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = conn;
+
+    if (epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &ev) == -1) {
+      warn("epoll_ctl");
+      return 1;
+    }
+    conn->state = CONN_READING;
+  }
+
+  wheel_remove(&conn->timer);
+  wheel_add(wheel, &conn->timer, read_timeout);
+  return 0;
+}
+
+/**
+ * @brief lets a connection wait for new entries of the bulletin board
+ *
+ * Only the client closing the connection is reported by epoll meanwhile,
+ * the timer is armed for the end of the wait.
+ *
+ * @param epfd the epoll instance
+ * @param conn the connection with a waiting subscribe request
+ * @param wheel the timer wheel the deadlines are armed in
+ * @param waiting the list of waiting connections
+ *
+ * @returns 0 if the connection waits or 1 if it can be closed
+ */
+static int park_connection(int epfd, connection_t *conn, timer_wheel_t *wheel, connection_t **waiting) {
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLRDHUP;
+  ev.data.ptr = conn;
+
+  if (epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &ev) == -1) {
+    warn("epoll_ctl");
+    return 1;
+  }
+
+  wait_for_entries(conn, wheel, waiting);
+  return 0;
+}
+
+/**
+ * @brief adds a connection to the list of waiting connections
+ *
+ * The timer is armed for the end of the wait.
+ *
+ * @param conn the connection with a waiting subscribe request
+ * @param wheel the timer wheel the deadlines are armed in
+ * @param waiting the list of waiting connections
+ */
+static void wait_for_entries(connection_t *conn, timer_wheel_t *wheel, connection_t **waiting) {
+  time_t now = time(NULL);
+
+  conn->state = CONN_WAITING;
+
+  conn->prev_waiting = NULL;
+  conn->next_waiting = *waiting;
+  if (*waiting != NULL) {
+    (*waiting)->prev_waiting = conn;
+  }
+  *waiting = conn;
+
+  /* one second more, as the wait ends in whole seconds */
+  wheel_remove(&conn->timer);
+  wheel_add(wheel, &conn->timer, (conn->session.wait_until > now) ? (long)(conn->session.wait_until - now) + 1 : 1);
+  v("%s\n", "Waiting for new entries");
+}
+
+/**
+ * @brief removes a connection from the list of waiting connections
+ *
+ * @param conn the waiting connection
+ * @param waiting the list of waiting connections
+ */
+static void unpark_connection(connection_t *conn, connection_t **waiting) {
+  if (conn->prev_waiting != NULL) {
+    conn->prev_waiting->next_waiting = conn->next_waiting;
+  } else {
+    *waiting = conn->next_waiting;
+  }
+  if (conn->next_waiting != NULL) {
+    conn->next_waiting->prev_waiting = conn->prev_waiting;
+  }
+  conn->next_waiting = conn->prev_waiting = NULL;
+}
+
+/**
+ * @brief reads what is available of the requests
+ *
+ * Reading stops when the client has shut down its sending direction or
+ * the buffer is full.
+ *
+ * @param conn the connection
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int read_request(connection_t *conn) {
+  ssize_t cnt;
+
+  while (!conn->eof && conn->input_len < sizeof(conn->input)) {
+    cnt = read(conn->fd, conn->input + conn->input_len, sizeof(conn->input) - conn->input_len);
+
+    if (cnt == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return 0;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      warn("read");
+      return -1;
+    }
+
+    if (cnt == 0) {
+      conn->eof = 1; /* SHUT_WR by the peer */
+    }
+
+    conn->input_len += (size_t)cnt;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief hands the buffered input to the logic
+ *
+ * The complete requests are consumed and their responses are appended to
+ * the response of the connection, the rest stays buffered. The logic
+ * always consumes something from a full buffer.
+ *
+ * @param conn the connection
+ *
+ * @returns 0 if everything went well or -1 if the connection has to be closed
+ */
+static int process_input(connection_t *conn) {
+  ssize_t cnt;
+
+  cnt = smsl_process_input(&conn->session, conn->input, conn->input_len, conn->eof, &conn->response);
+  if (cnt == -1) {
+    return -1;
+  }
+
+  if (cnt > 0) {
+    v("%zd bytes of requests processed\n", cnt);
+    memmove(conn->input, conn->input + cnt, conn->input_len - (size_t)cnt);
+    conn->input_len -= (size_t)cnt;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief writes what the socket accepts of the response
+ *
+ * @param conn the connection
+ *
+ * @returns 1 if the response is sent, 0 if more is pending or -1 in case of error
+ */
+static int write_response(connection_t *conn) {
+  ssize_t cnt;
+
+  while (conn->written < conn->response.len) {
+    cnt = send(conn->fd, conn->response.data + conn->written, conn->response.len - conn->written,
+               MSG_NOSIGNAL);
+
+    if (cnt == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return 0;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      warn("send");
+      return -1;
+    }
+
+    conn->written += (size_t)cnt;
+  }
+
+  v("Response of %zu bytes sent\n", conn->written);
+  return 1;
+}
+
+/**
+ * @brief closes the socket and frees the connection
+ *
+ * Closing the descriptor also removes it from the epoll instance.
+ *
+ * @param conn the connection
+ */
+static void close_connection(connection_t *conn) {
+  wheel_remove(&conn->timer);
+  close(conn->fd);
+  free(conn->response.data);
+  free(conn);
+}
+
+/**
+ * @brief a single-process server driving all sockets through io_uring
+ *
+ * A multishot accept keeps delivering new connections without being
+ * rearmed. The requests are received into buffers provided to the kernel
+ * up front, so idle connections do not pin any memory. The last response
+ * is sent with a send linked to the close of the socket. The deadlines
+ * are kept in a timer wheel as with epoll, the wait for completions
+ * ends after a tick of it. A multishot poll on the board watch wakes
+ * the connections with a waiting subscribe request.
+ *
+ * @param sock the server socket
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int uring_loop(int sock) {
+  uring_t ring;
+  struct io_uring_cqe cqe;
+  wheel_timer_t expired;
+  connection_t *conn;
+  unsigned head;
+  unsigned tail;
+
+  if (uring_init(&ring) == -1) {
+    /* error is printed by uring_init() */
+    close(sock);
+    return -1;
+  }
+
+  if (uring_provide(&ring, 0, URING_BUFFERS) == -1 || uring_accept(&ring, sock) == -1) {
+    uring_exit(&ring);
+    close(sock);
+    return -1;
+  }
+
+  /* without the board watch subscribe requests are rejected */
+  if ((ring.watch = smsl_watch_board()) != -1 && uring_watch(&ring) == -1) {
+    close(ring.watch);
+    ring.watch = -1;
+  }
+
+  while (1) {
+    if (uring_submit(&ring, 1) == -1) {
+      uring_exit(&ring);
+      close(sock);
+      return -1;
+    }
+
+    head = *ring.cq_head;
+    tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+      /* copy the entry so the slot can be released before new requests are queued */
+      cqe = ring.cqes[head & ring.cq_mask];
+      __atomic_store_n(ring.cq_head, ++head, __ATOMIC_RELEASE);
+
+      if (uring_complete(&ring, sock, &cqe) == -1) {
+        uring_exit(&ring);
+        close(sock);
+        return -1;
+      }
+    }
+
+    /* the receive or send in flight is cancelled, its completion closes the connection */
+    wheel_expire(&ring.wheel, &expired);
+    while (expired.next != &expired) {
+      conn = (connection_t *)expired.next;
+      wheel_remove(&conn->timer);
+
+      /* a subscribe request which waited long enough is answered */
+      if (conn->state == CONN_WAITING) {
+        if (uring_resume(&ring, conn) != 0) {
+          close_connection(conn);
+        }
+        continue;
+      }
+
+      v("%s\n", "Deadline passed, closing the connection");
+      if (uring_cancel(&ring, conn) == -1) {
+        wheel_add(&ring.wheel, &conn->timer, 1); /* tried again later */
+      }
+    }
+  }
+
+  /* not reached */
+
+  return 0;
+}
+
+/**
+ * @brief sets up the rings and the receive buffers
+ *
+ * @param ring the ring to set up
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int uring_init(uring_t *ring) {
+  struct io_uring_params params;
+  size_t cq_size;
+
+  memset(ring, 0, sizeof(*ring));
+  memset(&params, 0, sizeof(params));
+
+  if ((ring->fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &params)) == -1) {
+    warn("io_uring_setup");
+    return -1;
+  }
+
+  if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP) ||
+      !(params.features & IORING_FEAT_EXT_ARG)) {
+    warnx("io_uring of the kernel is too old");
+    close(ring->fd);
+    return -1;
+  }
+
+  ring->rings_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (cq_size > ring->rings_size) {
+    ring->rings_size = cq_size;
+  }
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  if ((ring->rings = mmap(NULL, ring->rings_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                          IORING_OFF_SQ_RING)) == MAP_FAILED) {
+    warn("mmap");
+    close(ring->fd);
+    return -1;
+  }
+
+  if ((ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                         IORING_OFF_SQES)) == MAP_FAILED) {
+    warn("mmap");
+    munmap(ring->rings, ring->rings_size);
+    close(ring->fd);
+    return -1;
+  }
+
+  if ((ring->buffers = malloc((size_t)URING_BUFFERS * URING_BUFFER_SIZE)) == NULL) {
+    warn("malloc");
+    munmap(ring->sqes, ring->sqes_size);
+    munmap(ring->rings, ring->rings_size);
+    close(ring->fd);
+    return -1;
+  }
+
+  ring->sq_head = (unsigned *)(ring->rings + params.sq_off.head);
+  ring->sq_tail = (unsigned *)(ring->rings + params.sq_off.tail);
+  ring->sq_array = (unsigned *)(ring->rings + params.sq_off.array);
+  ring->sq_mask = *(unsigned *)(ring->rings + params.sq_off.ring_mask);
+  ring->sq_entries = *(unsigned *)(ring->rings + params.sq_off.ring_entries);
+  ring->cq_head = (unsigned *)(ring->rings + params.cq_off.head);
+  ring->cq_tail = (unsigned *)(ring->rings + params.cq_off.tail);
+  ring->cqes = (struct io_uring_cqe *)(ring->rings + params.cq_off.cqes);
+  ring->cq_mask = *(unsigned *)(ring->rings + params.cq_off.ring_mask);
+  wheel_init(&ring->wheel);
+  ring->watch = -1;
+
+  v("io_uring with %u entries\n", ring->sq_entries);
+  return 0;
+}
+
+/**
+ * @brief tears down the rings
+ *
+ * Connections still in flight are not freed, this is only used on the
+ * way out of the process or thread.
+ *
+ * @param ring the ring
+ */
+static void uring_exit(uring_t *ring) {
+  if (ring->watch != -1) {
+    close(ring->watch);
+  }
+  close(ring->fd);
+  munmap(ring->sqes, ring->sqes_size);
+  munmap(ring->rings, ring->rings_size);
+  free(ring->buffers);
+}
+
+/**
+ * @brief queues a new submission queue entry
+ *
+ * The ring is submitted to make room if it is full.
+ *
+ * @param ring the ring
+ * @param op the operation, reported back with the completion
+ * @param ptr the connection, reported back with the completion
+ *
+ * @returns the zeroed entry or NULL in case of error
+ */
+static struct io_uring_sqe *uring_get_sqe(uring_t *ring, uring_op op, void *ptr) {
+  struct io_uring_sqe *sqe;
+  unsigned tail = *ring->sq_tail;
+  unsigned index;
+
+  if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) == ring->sq_entries) {
+    if (uring_submit(ring, 0) == -1 ||
+        tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) == ring->sq_entries) {
+      warnx("io_uring submission queue full");
+      return NULL;
+    }
+  }
+
+  index = tail & ring->sq_mask;
+  sqe = &ring->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->user_data = (uint64_t)(uintptr_t)ptr | op;
+  ring->sq_array[index] = index;
+
+  __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ring->pending++;
+
+  return sqe;
+}
+
+/**
+ * @brief submits the queued entries to the kernel
+ *
+ * The wait for completions ends after a tick of the timer wheel.
+ *
+ * @param ring the ring
+ * @param wait the number of completions to wait for
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int uring_submit(uring_t *ring, unsigned wait) {
+  struct __kernel_timespec ts = {0, WHEEL_TICK_MS * 1000000L};
+  struct io_uring_getevents_arg arg;
+  long submitted;
+
+  memset(&arg, 0, sizeof(arg));
+  arg.ts = (uint64_t)(uintptr_t)&ts;
+
+  while ((submitted = syscall(__NR_io_uring_enter, ring->fd, ring->pending, wait,
+                              wait > 0 ? IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG : 0, wait > 0 ? &arg : NULL,
+                              wait > 0 ? sizeof(arg) : 0)) == -1) {
+    if (errno == EINTR) {
+      continue;
+    }
+    if (errno == EBUSY || errno == EAGAIN || errno == ETIME) {
+      return 0; /* the completions are reaped first or the tick is over */
+    }
+    warn("io_uring_enter");
+    return -1;
+  }
+
+  ring->pending -= (unsigned)submitted;
+  return 0;
+}
+
+/**
+ * @brief dispatches a completion queue entry
+ *
+ * @param ring the ring
+ * @param sock the server socket
+ * @param cqe the completion
+ *
+ * @returns 0 if everything went well or -1 in case of a fatal error
+ */
+static int uring_complete(uring_t *ring, int sock, const struct io_uring_cqe *cqe) {
+  connection_t *conn = (connection_t *)(uintptr_t)(cqe->user_data & ~(uint64_t)URING_OP_MASK);
+  connection_t *next;
+
+  switch ((uring_op)(cqe->user_data & URING_OP_MASK)) {
+
+  case URING_ACCEPT:
+    if (cqe->res >= 0) {
+      v("%s\n", "Accepted a connection");
+      if ((conn = calloc(1, sizeof(connection_t))) == NULL) {
+        warn("calloc");
+        close(cqe->res);
+      } else {
+        conn->fd = cqe->res;
+        conn->state = CONN_READING;
+        conn->session.watching = (ring->watch != -1);
+        if (uring_recv(ring, conn) == -1) {
+          close_connection(conn);
+        } else {
+          wheel_add(&ring->wheel, &conn->timer, read_timeout);
+        }
+      }
+    } else if (cqe->res == -EINVAL) {
+      warnx("io_uring of the kernel does not support multishot accept");
+      return -1;
+    } else {
+      /* the connection is lost, e.g. ECONNABORTED or EMFILE */
+      errno = -cqe->res;
+      warn("accept");
+    }
+    /* the accept stays armed as long as the kernel says so */
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+      return uring_accept(ring, sock);
+    }
+    return 0;
+
+  case URING_RECV:
+    if (uring_received(ring, conn, cqe) != 0) {
+      close_connection(conn);
+    }
+    return 0;
+
+  case URING_SEND:
+    if (uring_sent(ring, conn, cqe->res) != 0) {
+      close_connection(conn);
+    }
+    return 0;
+
+  case URING_CLOSE:
+    /* a close cancelled by a short send has been queued again */
+    if (cqe->res == -ECANCELED) {
+      return 0;
+    }
+    if (cqe->res < 0) {
+      errno = -cqe->res;
+      warn("close");
+    }
+    wheel_remove(&conn->timer);
+    free(conn->response.data);
+    free(conn);
+    return 0;
+
+  case URING_PROVIDE:
+    if (cqe->res < 0) {
+      errno = -cqe->res;
+      warn("io_uring provide buffers");
+      return -1;
+    }
+    return 0;
+
+  case URING_CANCEL:
+    /* the cancelled operation reports the connection, it may have completed already */
+    return 0;
+
+  case URING_WATCH:
+    if (cqe->res < 0) {
+      /* the waiting connections are answered at the end of their wait */
+      errno = -cqe->res;
+      warn("io_uring poll");
+      return 0;
+    }
+    if (smsl_board_changed(ring->watch) == 1) {
+      for (conn = ring->waiting; conn != NULL; conn = next) {
+        next = conn->next_waiting;
+        if (uring_resume(ring, conn) != 0) {
+          close_connection(conn);
+        }
+      }
+    }
+    /* the poll stays armed as long as the kernel says so */
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+      return uring_watch(ring);
+    }
+    return 0;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief arms the multishot accept on the server socket
+ *
+ * @param ring the ring
+ * @param sock the server socket
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int uring_accept(uring_t *ring, int sock) {
+  struct io_uring_sqe *sqe;
+
+  if ((sqe = uring_get_sqe(ring, URING_ACCEPT, NULL)) == NULL) {
+    return -1;
+  }
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = sock;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->accept_flags = SOCK_CLOEXEC;
+
+  return 0;
+}
+
+/**
+ * @brief hands receive buffers (back) to the kernel
+ *
+ * @param ring the ring
+ * @param first the id of the first buffer
+ * @param count the number of buffers
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int uring_provide(uring_t *ring, unsigned first, unsigned count) {
+  struct io_uring_sqe *sqe;
+
+  if ((sqe = uring_get_sqe(ring, URING_PROVIDE, NULL)) == NULL) {
+    return -1;
+  }
+  sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+  sqe->fd = (int)count;
+  sqe->addr = (uint64_t)(uintptr_t)(ring->buffers + (size_t)first * URING_BUFFER_SIZE);
+  sqe->len = URING_BUFFER_SIZE;
+  sqe->off = first;
+  sqe->buf_group = URING_BUFFER_GROUP;
+
+  return 0;
+}
+
+/**
+ * @brief queues a receive into one of the provided buffers
+ *
+ * @param ring the ring
+ * @param conn the connection
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int uring_recv(uring_t *ring, connection_t *conn) {
+  struct io_uring_sqe *sqe;
+
+  if ((sqe = uring_get_sqe(ring, URING_RECV, conn)) == NULL) {
+    return -1;
+  }
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = conn->fd;
+  /* no more than fits into the input buffer */
+  sqe->len = (unsigned)((sizeof(conn->input) - conn->input_len < URING_BUFFER_SIZE)
+                            ? sizeof(conn->input) - conn->input_len
+                            : URING_BUFFER_SIZE);
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = URING_BUFFER_GROUP;
+
+  return 0;
+}
+
+/**
+ * @brief consumes a completed receive
+ *
+ * The data is copied out of the provided buffer, which is given back
+ * right away, and the complete requests are answered.
+ *
+ * @param ring the ring
+ * @param conn the connection
+ * @param cqe the completion of the receive
+ *
+ * @returns 0 if the connection stays open or 1 if it can be closed
+ */
+static int uring_received(uring_t *ring, connection_t *conn, const struct io_uring_cqe *cqe) {
+  unsigned id;
+
+  if (cqe->res == -ENOBUFS) {
+    /* all buffers are in use, they are given back with this batch */
+    return (uring_recv(ring, conn) == -1) ? 1 : 0;
+  }
+
+  if (cqe->res == -ECANCELED) {
+    return 1; /* the deadline passed */
+  }
+
+  if (cqe->res < 0) {
+    errno = -cqe->res;
+    warn("recv");
+    return 1;
+  }
+
+  if (cqe->flags & IORING_CQE_F_BUFFER) {
+    id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    memcpy(conn->input + conn->input_len, ring->buffers + (size_t)id * URING_BUFFER_SIZE, (size_t)cqe->res);
+    conn->input_len += (size_t)cqe->res;
+
+    if (uring_provide(ring, id, 1) == -1) {
+      return 1;
+    }
+  }
+
+  if (cqe->res == 0) {
+    conn->eof = 1; /* SHUT_WR by the peer */
+  }
+
+  if (process_input(conn) == -1) {
+    return 1;
+  }
+
+  return uring_respond(ring, conn);
+}
+
+/**
+ * @brief sends the responses to the requests processed so far
+ *
+ * The last response is linked to the close of the socket. Without a
+ * response, the connection receives the rest of the request or waits
+ * for new entries of the bulletin board.
+ *
+ * @param ring the ring
+ * @param conn the connection
+ *
+ * @returns 0 if the connection stays open or 1 if it can be closed
+ */
+static int uring_respond(uring_t *ring, connection_t *conn) {
+  if (conn->response.len == 0) {
+    if (conn->session.done) {
+      return 1;
+    }
+    if (conn->session.wait_until != 0) {
+      wait_for_entries(conn, &ring->wheel, &ring->waiting);
+      return 0;
+    }
+    return (uring_recv(ring, conn) == -1) ? 1 : 0; /* more of the request is expected */
+  }
+
+  conn->state = conn->session.done ? CONN_CLOSING : CONN_WRITING;
+  wheel_remove(&conn->timer);
+  wheel_add(&ring->wheel, &conn->timer, write_timeout);
+  return (uring_send(ring, conn) == -1) ? 1 : 0;
+}
+
+/**
+ * @brief queues the rest of the responses
+ *
+ * The logic renders the responses into one buffer, so a single send
+ * covers the status, the HTML page and the PNG image of all of them.
+ * The last responses are linked to the close of the socket.
+ *
+ * @param ring the ring
+ * @param conn the connection
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int uring_send(uring_t *ring, connection_t *conn) {
+  struct io_uring_sqe *sqe;
+
+  if ((sqe = uring_get_sqe(ring, URING_SEND, conn)) == NULL) {
+    return -1;
+  }
+  sqe->opcode = IORING_OP_SEND;
+  sqe->fd = conn->fd;
+  sqe->addr = (uint64_t)(uintptr_t)(conn->response.data + conn->written);
+  sqe->len = (unsigned)(conn->response.len - conn->written);
+  sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+
+  if (conn->state != CONN_CLOSING) {
+    return 0;
+  }
+  sqe->flags = IOSQE_IO_LINK; /* a short send cancels the close */
+
+  if ((sqe = uring_get_sqe(ring, URING_CLOSE, conn)) == NULL) {
+    /* the send is already queued, the connection is closed after its completion */
+    conn->state = CONN_WRITING;
+    return 0;
+  }
+  sqe->opcode = IORING_OP_CLOSE;
+  sqe->fd = conn->fd;
+
+  return 0;
+}
+
+/**
+ * @brief consumes a completed send
+ *
+ * @param ring the ring
+ * @param conn the connection
+ * @param res the result of the send
+ *
+ * @returns 0 if the connection stays open or is closed by the linked close,
+ *          1 if it has to be closed
+ */
+static int uring_sent(uring_t *ring, connection_t *conn, int res) {
+  if (res == -ECANCELED) {
+    return 1; /* the deadline passed */
+  }
+
+  if (res < 0) {
+    errno = -res;
+    warn("send");
+    return 1;
+  }
+
+  conn->written += (size_t)res;
+  if (conn->written < conn->response.len) {
+    return (uring_send(ring, conn) == -1) ? 1 : 0;
+  }
+
+  v("Response of %zu bytes sent\n", conn->written);
+
+  if (conn->state == CONN_CLOSING) {
+    return 0;
+  }
+  if (conn->session.done) {
+    return 1; /* the close could not be queued along with the send */
+  }
+
+  /* everything is answered, wait for the next request */
+  conn->response.len = 0;
+  conn->written = 0;
+  if (conn->session.wait_until != 0) {
+    wait_for_entries(conn, &ring->wheel, &ring->waiting);
+    return 0;
+  }
+
+  conn->state = CONN_READING;
+  wheel_remove(&conn->timer);
+  wheel_add(&ring->wheel, &conn->timer, read_timeout);
+  return (uring_recv(ring, conn) == -1) ? 1 : 0;
+}
+
+/**
+ * @brief answers a waiting subscribe request
+ *
+ * Nothing is in flight for a waiting connection, so a client closing it
+ * meanwhile is only noticed when the answer is sent.
+ *
+ * @param ring the ring
+ * @param conn the waiting connection
+ *
+ * @returns 0 if the connection stays open or 1 if it can be closed
+ */
+static int uring_resume(uring_t *ring, connection_t *conn) {
+  unpark_connection(conn, &ring->waiting);
+  conn->state = CONN_READING;
+  wheel_remove(&conn->timer);
+  wheel_add(&ring->wheel, &conn->timer, read_timeout);
+
+  if (process_input(conn) == -1) {
+    return 1;
+  }
+
+  return uring_respond(ring, conn);
+}
+
+/**
+ * @brief cancels the receive or send of a connection whose deadline passed
+ *
+ * A connection has a single operation in flight, a receive while it
+ * reads and otherwise a send along with the close linked to it. The
+ * operation is matched by its user_data rather than by the descriptor,
+ * which a new connection may have been given already. The cancelled
+ * operation completes with ECANCELED and the connection is closed then.
+ *
+ * @param ring the ring
+ * @param conn the connection
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int uring_cancel(uring_t *ring, connection_t *conn) {
+  struct io_uring_sqe *sqe;
+
+  if ((sqe = uring_get_sqe(ring, URING_CANCEL, NULL)) == NULL) {
+    return -1;
+  }
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = (uint64_t)(uintptr_t)conn | ((conn->state == CONN_READING) ? URING_RECV : URING_SEND);
+
+  return 0;
+}
+
+/**
+ * @brief arms the multishot poll on the board watch
+ *
+ * @param ring the ring
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int uring_watch(uring_t *ring) {
+  struct io_uring_sqe *sqe;
+
+  if ((sqe = uring_get_sqe(ring, URING_WATCH, NULL)) == NULL) {
+    return -1;
+  }
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = ring->watch;
+  sqe->poll32_events = POLLIN;
+  sqe->len = IORING_POLL_ADD_MULTI;
+
+  return 0;
+}
+
+/**
+ * @brief returns the monotonic time in ticks of the timer wheel
+ *
+ * @returns the number of ticks
+ */
+static uint64_t wheel_ticks(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000) / WHEEL_TICK_MS;
+}
+
+/**
+ * @brief sets up an empty timer wheel starting at the current tick
+ *
+ * Every slot is the sentinel of a circular doubly linked list.
+ *
+ * @param wheel the timer wheel
+ */
+static void wheel_init(timer_wheel_t *wheel) {
+  int i;
+
+  wheel->now = wheel_ticks();
+  for (i = 0; i < WHEEL_INNER_SLOTS; i++) {
+    wheel->inner[i].next = wheel->inner[i].prev = &wheel->inner[i];
+  }
+  for (i = 0; i < WHEEL_OUTER_SLOTS; i++) {
+    wheel->outer[i].next = wheel->outer[i].prev = &wheel->outer[i];
+  }
+}
+
+/**
+ * @brief arms a timer
+ *
+ * @param wheel the timer wheel
+ * @param timer the timer, must not be armed
+ * @param seconds the time until the timer expires, 0 if it never does
+ */
+static void wheel_add(timer_wheel_t *wheel, wheel_timer_t *timer, long seconds) {
+  if (seconds == 0) {
+    return;
+  }
+
+  timer->expires = wheel->now + (uint64_t)seconds * 1000 / WHEEL_TICK_MS;
+  wheel_link(wheel, timer);
+}
+
+/**
+ * @brief links a timer into the slot of its expiry
+ *
+ * Timers expiring within WHEEL_INNER_SLOTS ticks go into the inner wheel,
+ * the others into the outer wheel, one slot per turn of the inner wheel.
+ *
+ * @param wheel the timer wheel
+ * @param timer the timer, must not be armed
+ */
+static void wheel_link(timer_wheel_t *wheel, wheel_timer_t *timer) {
+  wheel_timer_t *slot;
+
+  if (timer->expires - wheel->now < WHEEL_INNER_SLOTS) {
+    slot = &wheel->inner[timer->expires & (WHEEL_INNER_SLOTS - 1)];
+  } else {
+    slot = &wheel->outer[(timer->expires >> WHEEL_INNER_BITS) & (WHEEL_OUTER_SLOTS - 1)];
+  }
+
+  timer->next = slot;
+  timer->prev = slot->prev;
+  slot->prev->next = timer;
+  slot->prev = timer;
+}
+
+/**
+ * @brief unlinks a timer, if it is armed
+ *
+ * @param timer the timer
+ */
+static void wheel_remove(wheel_timer_t *timer) {
+  if (timer->next == NULL) {
+    return;
+  }
+
+  timer->prev->next = timer->next;
+  timer->next->prev = timer->prev;
+  timer->next = timer->prev = NULL;
+}
+
+/**
+ * @brief advances the timer wheel to the current tick
+ *
+ * At the start of every turn of the inner wheel the matching outer slot is
+ * cascaded into the inner wheel. The expired timers are moved to a list
+ * the caller has to empty by removing them.
+ *
+ * @param wheel the timer wheel
+ * @param expired the sentinel of the list of expired timers
+ */
+static void wheel_expire(timer_wheel_t *wheel, wheel_timer_t *expired) {
+  uint64_t now = wheel_ticks();
+  wheel_timer_t *slot;
+  wheel_timer_t *timer;
+
+  expired->next = expired->prev = expired;
+
+  while (wheel->now < now) {
+    wheel->now++;
+
+    if ((wheel->now & (WHEEL_INNER_SLOTS - 1)) == 0) {
+      slot = &wheel->outer[(wheel->now >> WHEEL_INNER_BITS) & (WHEEL_OUTER_SLOTS - 1)];
+      while ((timer = slot->next) != slot) {
+        wheel_remove(timer);
+        wheel_link(wheel, timer);
+      }
+    }
+
+    slot = &wheel->inner[wheel->now & (WHEEL_INNER_SLOTS - 1)];
+    if (slot->next != slot) {
+      /* move the whole slot */
+      slot->next->prev = expired->prev;
+      expired->prev->next = slot->next;
+      slot->prev->next = expired;
+      expired->prev = slot->prev;
+      slot->next = slot->prev = slot;
+    }
+  }
+}
+
+/**
+ * @brief raises the soft limit of open files to the hard limit
+ *
+ * Every connection needs a descriptor, the default soft limit of
+ * 1024 would cap the number of concurrent clients.
+ */
+static void raise_fd_limit(void) {
+  struct rlimit limit;
+
+  if (getrlimit(RLIMIT_NOFILE, &limit) == -1) {
+    warn("getrlimit");
+    return;
+  }
+
+  if (limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    if (setrlimit(RLIMIT_NOFILE, &limit) == -1) {
+      warn("setrlimit");
+      return;
+    }
+  }
+  v("Open files limit: %llu\n", (unsigned long long)limit.rlim_cur);
+}
+
+/**
+ * @brief runs one event loop with its own listener per thread
+ *
+ * Each thread binds its own SO_REUSEPORT socket, so the kernel
+ * distributes the incoming connections and no accept lock is shared.
+ * The threads are pinned to the CPUs the process may run on.
+ *
+ * @param port the port number
+ * @param threads the number of threads
+ * @param backend the event loop run by the threads
+ *
+ * @returns 0 if everything went well or -1 in case of error
+ */
+static int start_listeners(char *port, long threads, backend_t backend) {
+  listener_t *listeners;
+  cpu_set_t allowed;
+  int cpus = 0;
+  int cpu = -1;
+  int status = 0;
+  long started;
+  long i;
+
+  if ((listeners = calloc((size_t)threads, sizeof(listener_t))) == NULL) {
+    warn("calloc");
+    return -1;
+  }
+
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+    warn("sched_getaffinity");
+    CPU_ZERO(&allowed);
+  }
+  cpus = CPU_COUNT(&allowed);
+
+  raise_fd_limit();
+
+  for (started = 0; started < threads; started++) {
+    listeners[started].port = port;
+    listeners[started].backend = backend;
+    listeners[started].cpu = -1;
+
+    /* assign the allowed CPUs round-robin */
+    if (cpus > 0) {
+      do {
+        cpu = (cpu + 1) % CPU_SETSIZE;
+      } while (!CPU_ISSET(cpu, &allowed));
+      listeners[started].cpu = cpu;
+    }
+
+    if ((errno = pthread_create(&listeners[started].thread, NULL, listener_thread, &listeners[started])) !=
+        0) {
+      warn("pthread_create");
+      status = -1;
+      break;
+    }
+  }
+
+  /* the threads only return in case of error */
+  for (i = 0; i < started; i++) {
+    if ((errno = pthread_join(listeners[i].thread, NULL)) != 0) {
+      warn("pthread_join");
+      status = -1;
+    } else if (listeners[i].status == -1) {
+      status = -1;
+    }
+  }
+
+  free(listeners);
+
+  return status;
+}
+
+/**
+ * @brief thread entry point of start_listeners()
+ *
+ * @param arg the listener_t of the thread
+ *
+ * @returns NULL, the result is stored in the listener_t
+ */
+static void *listener_thread(void *arg) {
+  listener_t *listener = arg;
+  cpu_set_t cpuset;
+  int sock;
+
+  if (listener->cpu != -1) {
+    CPU_ZERO(&cpuset);
+    CPU_SET(listener->cpu, &cpuset);
+    if ((errno = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset)) != 0) {
+      warn("pthread_setaffinity_np");
+    } else {
+      v("Listener pinned to CPU %d\n", listener->cpu);
+    }
+  }
+
+  if ((sock = init_sock(listener->port, 1)) == -1) {
+    /* error is printed by init_sock() */
+    listener->status = -1;
+    return NULL;
+  }
+
+  /* the loops only return in case of error */
+  if (listener->backend == BACKEND_URING) {
+    listener->status = uring_loop(sock);
+  } else {
+    listener->status = event_loop(sock);
+  }
+
+  return NULL;
 }
@@ -0,0 +1,121 @@
+#!/bin/sh
+#
+# Posts concurrently from many clients to two servers sharing the message
+# store, an inproc server (a thread per connection) and an epoll server
+# with four threads, then reads everything back and checks that every
+# message arrived exactly once and whole: no record torn, interleaved
+# with another one or lost.
+#
+# The posts go to the bulletin board of the user running the test, with
+# the user name concurrency_test.
+#
+# usage: concurrent_posts.sh simple_message_server simple_message_client
+#
+# The directory ~/public_html has to exist.
+
+SERVER=$1
+CLIENT=$2
+WRITERS=8 # per server
+POSTS=40  # per writer, half of them singly, half in batches
+RUN=$$
+TMP=$(mktemp -d) || exit 1
+
+cleanup() {
+  kill $PIDS 2>/dev/null
+  wait 2>/dev/null
+  rm -rf "$TMP"
+}
+PIDS=
+trap cleanup EXIT
+
+fail() {
+  echo "FAIL: $*" >&2
+  exit 1
+}
+
+# the messages only consist of characters the HTML of an entry keeps as they are and
+# fit into the 1024 bytes of a message with the prefix
+message() {
+  len=$(( ($1 * 7919 + $2 * 104729) % 900 + 1 ))
+  printf 'ct:%s:%s:%s:%s:' "$RUN" "$1" "$2" "$len"
+  head -c "$len" /dev/zero | tr '\0' "$(printf '\\%03o' $(( 97 + ($1 + $2) % 26 )))"
+  echo
+}
+
+start_server() {
+  "$SERVER" -p "$1" $2 >/dev/null 2>>"$TMP/server.err" &
+  PIDS="$PIDS $!"
+}
+
+[ -d "$HOME/public_html" ] || fail "the bulletin board needs the directory ~/public_html"
+
+INPROC=$(( 20000 + $$ % 20000 ))
+EPOLL=$(( INPROC + 1 ))
+start_server "$INPROC" "-b inproc"
+start_server "$EPOLL" "-b epoll -t 4"
+sleep 1
+
+# the cursor before the first post
+"$CLIENT" -s localhost -p "$EPOLL" -f 1 >/dev/null 2>"$TMP/cursor" || fail "cannot fetch from the server"
+START=$(sed -n 's/^cursor=//p' "$TMP/cursor")
+[ -n "$START" ] || fail "no cursor"
+
+WAIT=
+for port in "$INPROC" "$EPOLL"; do
+  w=0
+  while [ $w -lt $WRITERS ]; do
+    id=$(( w + (port == EPOLL ? WRITERS : 0) ))
+    (
+      k=0
+      while [ $k -lt $(( POSTS / 2 )) ]; do
+        "$CLIENT" -s localhost -p "$port" -u concurrency_test -m "$(message $id $k)" >/dev/null 2>>"$TMP/client.err" ||
+          echo "post $id $k" >>"$TMP/errors"
+        k=$(( k + 1 ))
+      done
+      while [ $k -lt $POSTS ]; do
+        message $id $k
+        k=$(( k + 1 ))
+      done | "$CLIENT" -s localhost -p "$port" -u concurrency_test -m - -V 2 -b 4 -n >/dev/null 2>>"$TMP/client.err" ||
+        echo "batch $id" >>"$TMP/errors"
+    ) &
+    WAIT="$WAIT $!"
+    w=$(( w + 1 ))
+  done
+done
+for pid in $WAIT; do
+  wait "$pid"
+done
+[ -s "$TMP/errors" ] && fail "posts failed: $(tr '\n' ' ' <"$TMP/errors")- $(head -c 500 "$TMP/client.err")"
+
+# read everything after the cursor, a page at a time
+cursor=$START
+while :; do
+  "$CLIENT" -s localhost -p "$EPOLL" -f 100 -a "$cursor" >>"$TMP/entries" 2>"$TMP/cursor" || fail "cannot fetch from the server"
+  next=$(sed -n 's/^cursor=//p' "$TMP/cursor")
+  [ "$next" = "$cursor" ] && break
+  cursor=$next
+done
+
+EXPECTED=$(( 2 * WRITERS * POSTS ))
+[ $(( cursor - START )) -eq $EXPECTED ] || fail "$(( cursor - START )) records instead of $EXPECTED"
+
+grep "ct:$RUN:" "$TMP/entries" | sed 's/^ *//' >"$TMP/messages"
+awk -F: -v expected=$EXPECTED '
+  {
+    if (NF != 6 || length($6) != $5 || $6 !~ ("^" sprintf("%c", 97 + ($3 + $4) % 26) "+$"))
+      bad++
+    else if (seen[$3 ":" $4]++)
+      dup++
+    n++
+  }
+  END {
+    if (bad || dup || n != expected) {
+      printf "%d messages, %d torn, %d duplicated, %d expected\n", n, bad, dup, expected
+      exit 1
+    }
+  }' "$TMP/messages" || fail "the board does not hold the messages as posted"
+
+grep -q . "$TMP/server.err" && fail "the servers reported errors: $(head -c 500 "$TMP/server.err")"
+
+echo "$EXPECTED messages posted concurrently, none torn, interleaved or lost"
+exit 0